@@ -73,6 +73,8 @@ public:
   virtual llvm::Constant* getStringPtr(JavaString** str);
   virtual llvm::Constant* getResolvedConstantPool(JavaConstantPool* ctp);
   virtual llvm::Constant* getNativeFunction(JavaMethod* meth, void* natPtr);
+  virtual llvm::Constant* getSafepointPollOffset();
+  virtual llvm::Constant* getLockBiasStates();
   
   virtual void setMethod(llvm::Function* func, void* ptr, const char* name);
   
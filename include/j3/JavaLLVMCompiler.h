@@ -203,6 +203,15 @@ public:
   virtual llvm::Constant* getStringPtr(JavaString** str) = 0;
   virtual llvm::Constant* getResolvedConstantPool(JavaConstantPool* ctp) = 0;
   virtual llvm::Constant* getNativeFunction(JavaMethod* meth, void* natPtr) = 0;
+
+  /// getSafepointPollOffset - The offset from the thread of the page that
+  /// compiled code reads at safe points, or NULL to poll the doYield flag of
+  /// the thread instead.
+  virtual llvm::Constant* getSafepointPollOffset() { return NULL; }
+
+  /// getLockBiasStates - The bias states of the lock system, that inlined
+  /// monitor code reads, or NULL to leave biased locks to the runtime.
+  virtual llvm::Constant* getLockBiasStates() { return NULL; }
   
   virtual void setMethod(llvm::Function* func, void* ptr, const char* name) = 0;
   
@@ -10,52 +10,135 @@
 #ifndef _VMKIT_COLLECTIONRV_H_
 #define _VMKIT_COLLECTIONRV_H_
 
-#include "vmkit/Cond.h"
 #include "vmkit/Locks.h"
 #include "vmkit/Thread.h"
 
 namespace vmkit {
 
+class FrameInfo;
+
+/// SafepointRecord - What the safepoint log reports about a rendezvous.
+struct SafepointRecord {
+  /// startTime - When the initiator asked threads to yield, in nanoseconds.
+  uint64_t startTime;
+
+  /// timeToSafepoint - How long all threads took to join, in nanoseconds.
+  uint64_t timeToSafepoint;
+
+  /// nbThreads - Number of threads stopped by the rendezvous.
+  uint32_t nbThreads;
+
+  /// slowest - The thread that joined last, or NULL if the initiator found
+  /// all threads already stopped.
+  Thread* slowest;
+
+  /// frame, ip, addr - The last Java frame of the slowest thread.
+  FrameInfo* frame;
+  word_t ip;
+  word_t addr;
+};
+
 class CollectionRV {
 protected: 
-  /// _lockRV - Lock for synchronization.
-  LockNormal _lockRV;         
-  
-  /// condEndRV - Condition for unlocking other tasks (write protect).
-  Cond condEndRV;
-
-  /// collectionCond - Condition for unblocking the initator.
-  Cond condInitiator;
+  /// nbJoined - Number of threads that joined the rendezvous. The initiator
+  /// futex-waits on this word until all threads are counted.
+  volatile int32_t nbJoined;
 
-  /// nbJoined - Number of threads that joined the rendezvous.
-  unsigned nbJoined;
+  /// rvEpoch - Incremented each time a rendezvous ends. Threads that joined
+  /// futex-wait on this word until the initiator releases them.
+  volatile int32_t rvEpoch;
 
   // initiator - The initiator of the rendesvous.
-  Thread* initiator;
+  Thread* volatile initiator;
+
+  /// handshakeTarget - The thread a handshake is running for, if any. A
+  /// handshake owns the initiator slot, so it never overlaps a rendezvous.
+  Thread* volatile handshakeTarget;
+
+  void joinHandshake(Thread* th);
+
+  /// pollingPages - When true, compiled code polls for safe points by
+  /// reading the polling page of its thread. The pages of the threads that
+  /// must yield are protected, and the SIGSEGV handler makes the reader join.
+  bool pollingPages;
+
+  void protectPollingPage(Thread* th);
+  void unprotectPollingPage(Thread* th);
+
+  /// safepointLog - When not NULL, every rendezvous is reported to this file.
+  FILE* safepointLog;
+
+  /// lastJoined - The thread whose join completed the current rendezvous.
+  Thread* volatile lastJoined;
+
+  /// nbRendezvous - Number of rendezvous since the log was opened.
+  uint64_t nbRendezvous;
+
+  /// record - The rendezvous being logged.
+  SafepointRecord record;
+
+  void recordTimeToSafepoint(Thread* th, uint64_t delay);
+  void recordSlowestThread();
+  void logRendezvous(Thread* self);
   
 public: 
   CollectionRV() {
     nbJoined = 0;
+    rvEpoch = 0;
     initiator = NULL;
+    handshakeTarget = NULL;
+    pollingPages = false;
+    safepointLog = NULL;
+    lastJoined = NULL;
+    nbRendezvous = 0;
   }
 
-  void lockRV() { _lockRV.lock(); }
-  void unlockRV() { _lockRV.unlock(); }
+  /// openSafepointLog - Report the time to safepoint of every rendezvous,
+  /// and per thread histograms, to the given file. Returns false if the file
+  /// can not be opened.
+  bool openSafepointLog(const char* name);
+
+  /// logThreadHistogram - Report the time to safepoint histogram of a thread.
+  void logThreadHistogram(Thread* th);
+
+  /// dumpSafepointHistograms - Report the histograms of all living threads.
+  void dumpSafepointHistograms();
+
+  bool isSafepointLogging() const { return safepointLog != NULL; }
+
+  /// enablePollingPage - Switch safe point polls of code compiled from now
+  /// on to the polling page. Returns false if the platform can not resume
+  /// from a poll fault.
+  bool enablePollingPage();
+
+  bool usesPollingPages() const { return pollingPages; }
+
+  bool isPollingPageAddr(Thread* th, word_t addr) const {
+    return pollingPages && addr - th->GetPollingPage() <
+      System::GetPageSize();
+  }
 
   void waitEndOfRV();
   void waitRV();
   
-  void startRV() {
-    vmkit::Thread::get()->inRV = true;
-    lockRV();
+  /// startRV - Try to become the initiator of a rendezvous. Returns false if
+  /// another thread already is.
+  bool startRV() {
+    vmkit::Thread* th = vmkit::Thread::get();
+    th->inRV = true;
+    return __sync_bool_compare_and_swap(&initiator, NULL, th);
   }
 
   void cancelRV() {
-    unlockRV();
     vmkit::Thread::get()->inRV = false;
   }
   
+  /// handshake - Stop only the target thread and run the closure on its
+  /// behalf. See Thread::handshake.
+  void handshake(Thread* target, HandshakeClosure* closure);
+
   void another_mark();
+  void joinAndWait(Thread* th);
   Thread* getInitiator() const { return initiator; }
 
   virtual void finishRV() = 0;
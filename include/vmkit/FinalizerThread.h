@@ -14,6 +14,10 @@ namespace vmkit {
 
 	template <class T_THREAD> class FinalizerThread : public T_THREAD {
 		public:
+		virtual vmkit::ThreadAffinity::Role getAffinityRole() {
+			return vmkit::ThreadAffinity::Finalizer;
+		}
+
 		/// FinalizationQueueLock - A lock to protect access to the queue.
 		///
 		vmkit::SpinLock FinalizationQueueLock;
@@ -29,9 +29,9 @@ class LockNormal;
 class LockRecursive;
 class Thread;
 
-extern LockNormal lockForCtrl_C;
-extern Cond condForCtrl_C;
-extern bool finishForCtrl_C;
+extern volatile bool finishForCtrl_C;
+extern volatile bool dumpForSigQuit;
+extern int pipeForCtrl_C[2];
 
 /// Lock - This class is an abstract class for declaring recursive and normal
 /// locks.
@@ -143,31 +143,55 @@ public:
   void lockAll(int count) __attribute__ ((noinline));
 };
 
-/// SpinLock - This class implements a spin lock. A spin lock is OK to use
-/// when it is held during short period of times. It is CPU expensive
-/// otherwise.
+/// SpinLock - This class implements a queued spin lock. A thread takes a free
+/// lock with one CAS. Otherwise it queues up, and spins on a node of its own,
+/// on its stack, until it is first in the queue. Only the first waiter polls
+/// the lock word. If it polls for too long, it asks for a handoff: the owner
+/// then passes the lock to it instead of freeing it, and it sleeps until
+/// then. Other waiters sleep too after spinning for a while. A spin lock is
+/// OK to use when it is held during short period of times.
 class SpinLock {
+  /// The bits of the lock word.
+  enum { Held = 1, Handoff = 2 };
+
+  /// The states of a queue node.
+  enum { Waiting, Sleeping, First };
+
+  struct Node {
+    Node* volatile next;
+    volatile int32_t state;
+  };
+
+  /// locked - Is the spin lock locked, and does the first waiter want it
+  /// handed over?
+  volatile int32_t locked;
+
+  /// tail - The last waiter, or NULL if there are none.
+  Node* volatile tail;
+
+  void acquireSlow() __attribute__ ((noinline));
+  void releaseSlow() __attribute__ ((noinline));
+
 public:
 
-  /// locked - Is the spin lock locked?
-  ///
-  uint32 locked;
-  
+  /// SpinCount - The number of times a waiter polls before it sleeps, and
+  /// the number of times the first waiter may see the lock taken before it
+  /// asks for a handoff.
+  static const uint32 SpinCount = 1000;
+
   /// SpinLock - Initialize the lock as not being held.
   ///
-  SpinLock() { locked = 0; }
+  SpinLock() {
+    locked = 0;
+    tail = NULL;
+  }
 
 
-  /// acquire - Acquire the spin lock, doing an active loop.
+  /// acquire - Acquire the spin lock, queueing up if it is held.
   ///
   void acquire() {
-    for (uint32 count = 0; count < 1000; ++count) {
-      uint32 res = __sync_val_compare_and_swap(&locked, 0, 1);
-      if (!res) return;
-    }
-    
-    while (__sync_val_compare_and_swap(&locked, 0, 1))
-      vmkit::Thread::yield();
+    if (__sync_bool_compare_and_swap(&locked, 0, Held)) return;
+    acquireSlow();
   }
 
   void lock() { acquire(); }
@@ -175,7 +199,10 @@ public:
   /// release - Release the spin lock. This must be called by the thread
   /// holding it.
   ///
-  void release() { locked = 0; }
+  void release() {
+    if (__sync_bool_compare_and_swap(&locked, Held, 0)) return;
+    releaseSlow();
+  }
   
   void unlock(vmkit::Thread* ownerThread = NULL) { release(); }
 };
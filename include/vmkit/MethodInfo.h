@@ -10,6 +10,8 @@
 #ifndef VMKIT_METHODINFO_H
 #define VMKIT_METHODINFO_H
 
+#include <cstdio>
+
 #include "vmkit/Allocator.h"
 #include "vmkit/System.h"
 #include "vmkit/GC.h"
@@ -28,7 +30,7 @@ public:
  
 class MethodInfoHelper {
 public:
-  static void print(word_t ip, word_t addr);
+  static void print(word_t ip, word_t addr, FILE* out = stderr);
 
   static void scan(word_t closure, FrameInfo* FI, word_t ip, word_t addr);
   
@@ -19,14 +19,24 @@
 namespace vmkit {
 
 class FatLock;
+class FrameInfo;
 class LockSystem;
+class VirtualMachine;
 
 class LockingThread {
 public:
-  /// varcond - Condition variable when the thread needs to be awaken from
-  /// a wait.
+  /// Wait states - The futex word a thread sleeps on in Object.wait. The
+  /// release of the monitor that follows a notify grants the monitor to the
+  /// thread, or the thread is interrupted, or its time is up.
   ///
-  vmkit::Cond varcond;
+  static const int32_t WaitSleeping = 0;
+  static const int32_t WaitGranted = 1;
+  static const int32_t WaitInterrupted = 2;
+  volatile int32_t waitState;
+
+  /// nextEntry - Next notified thread in the entry queue of the monitor.
+  ///
+  LockingThread* nextEntry;
 
   /// interruptFlag - Has this thread been interrupted?
   ///
@@ -60,14 +70,32 @@ public:
   /// state - The current state of this thread: Running, Waiting or Interrupted.
   uint32 state;
 
+  /// CachedLocks - How many free fat locks a thread keeps for itself.
+  ///
+  static const uint32_t CachedLocks = 8;
+
+  /// cachedLocks - Free fat locks the thread allocates from without taking
+  /// any lock. Given back with LockSystem::flushCache when the thread ends.
+  ///
+  FatLock* cachedLocks[CachedLocks];
+  uint32_t nbCachedLocks;
+
   LockingThread() {
     interruptFlag = 0;
     nextWaiting = NULL;
     prevWaiting = NULL;
     waitsOn = NULL;
     state = StateRunning;
+    nbCachedLocks = 0;
+    waitState = WaitGranted;
+    nextEntry = NULL;
   }
 
+  /// interruptWait - Wake up the thread if it sleeps in Object.wait. Its
+  /// interruptFlag must be set.
+  ///
+  void interruptWait();
+
   bool wait(gc* object, LockSystem& table, struct timeval* info, bool timed);
   void notify(gc* object, LockSystem& table, vmkit::Thread* ownerThread = NULL);
   void notifyAll(gc* object, LockSystem& table, vmkit::Thread* ownerThread = NULL);
@@ -81,11 +109,26 @@ private:
   uint32_t waitingThreads;
   uint32_t lockingThreads;
   LockingThread* firstThread;
+  LockingThread* firstEntry;
+  LockingThread* lastEntry;
   gc* associatedObject;
   uint32_t index;
   FatLock* nextFreeLock;
   bool associatedObjectDead;
 
+  /// Entry queue - Notified threads sleep there, instead of all waking up to
+  /// block on the internal lock, until a release of the monitor hands it to
+  /// the first one.
+  void pushEntry(LockingThread* th);
+  LockingThread* popEntry();
+  bool removeEntry(LockingThread* th);
+  static void grant(LockingThread* th);
+
+  /// releaseMonitor - Release the internal lock once, or all the times it is
+  /// held. If the monitor becomes free, grant it to the first thread of the
+  /// entry queue. Returns the number of times the lock was released.
+  int releaseMonitor(bool all, vmkit::Thread* ownerThread);
+
 public:
   FatLock(uint32_t index, gc* object);
   word_t getID();
@@ -99,6 +142,10 @@ public:
   gc* getAssociatedObject() { return associatedObject; }
   gc** getAssociatedObjectPtr() { return &associatedObject; }
   bool associatedObjectIsDead() const {return associatedObjectDead;}
+  bool isIdle() {
+    return !waitingThreads && !lockingThreads && !firstThread &&
+           !internalLock.getOwner();
+  }
   void markAssociatedObjectAsDead() {associatedObjectDead = true;}
 
   friend class LockSystem;
@@ -107,6 +154,101 @@ public:
 };
 
 
+/// LockProfiler - Samples contended acquisitions of object locks, and
+/// aggregates them by site: the top Java frame of the waiting thread. A site
+/// reports the type of the locked objects, how long threads waited, and where
+/// the owners were when they released the lock to the waiters. Running owners
+/// can not be walked, so their frame is the one of the release. Only
+/// contended acquisitions pay for the profile.
+///
+class LockProfiler {
+public:
+  /// kSites - The maximum number of sites. Events of other sites are lost.
+  static const uint32_t kSites = 1024;
+
+  /// kHolderSites - The number of owner sites reported per site.
+  static const uint32_t kHolderSites = 4;
+
+  /// kMinWait - Acquisitions that waited less, in nanoseconds, are not
+  /// counted: inflated locks go through the contended path even when free.
+  static const uint64_t kMinWait = 1000;
+
+  /// kDefaultSampleRate - Profile one contended acquisition in this many.
+  static const uint32_t kDefaultSampleRate = 16;
+
+  struct HolderSite {
+    FrameInfo* frame;
+    word_t ip;
+    uint64_t events;
+  };
+
+  struct Site {
+    FrameInfo* frame;
+    word_t ip;
+    const char* typeName;
+    uint64_t events;
+    uint64_t totalWait;
+    uint64_t maxWait;
+    HolderSite holders[kHolderSites];
+    uint64_t otherHolders;
+  };
+
+private:
+  /// Release slots - Hashed by object address. A sampled waiter asks the
+  /// owner of the lock for its frame, and the owner leaves it there when it
+  /// releases the lock. Unrelated locks may share a slot.
+  struct ReleaseSlot {
+    volatile uint32_t requested;
+    FrameInfo* volatile frame;
+    volatile word_t ip;
+  };
+  static const uint32_t kReleaseSlots = 256;
+  ReleaseSlot releaseSlots[kReleaseSlots];
+
+  FILE* output;
+  uint32_t sampleRate;
+  uint32_t contentions;
+  uint64_t lostEvents;
+  Site* sites;
+  vmkit::SpinLock lock;
+
+  ReleaseSlot& getReleaseSlot(gc* object);
+  Site* lookup(FrameInfo* frame);
+  void recordHolder(gc* object, vmkit::Thread* owner);
+
+public:
+  LockProfiler();
+
+  /// open - Profile contention to the given file. Returns false if the file
+  /// can not be opened.
+  bool open(const char* name);
+
+  void setSampleRate(uint32_t rate) { sampleRate = rate ? rate : 1; }
+
+  /// sample - Whether to profile the contended acquisition that starts.
+  /// Threads race on the count, which only skews sampling.
+  bool sample() {
+    return output != NULL && ++contentions % sampleRate == 0;
+  }
+
+  /// startWait - A sampled waiter starts waiting for the lock of the object.
+  void startWait(gc* object);
+
+  /// recordWait - A sampled waiter got the lock after waiting for the given
+  /// number of nanoseconds.
+  void recordWait(gc* object, vmkit::Thread* self, uint64_t wait);
+
+  /// recordRelease - The owner releases a lock that other threads may wait
+  /// for.
+  void recordRelease(gc* object, vmkit::Thread* owner) {
+    if (output != NULL) recordHolder(object, owner);
+  }
+
+  /// dump - Write the sites, the longest total wait first.
+  void dump(VirtualMachine* vm);
+};
+
+
 /// LockSystem - This class manages all Java locks used by the applications.
 /// Each JVM must own an instance of this class and allocate Java locks
 /// with it.
@@ -130,38 +272,124 @@ public:
   ///  
   FatLock* ** LockTable;
   
-  /// currentIndex - The current index in the tables. Always incremented,
-  /// never decremented.
+  /// currentIndex - The current index in the tables. Always incremented
+  /// atomically, never decremented.
   ///
   uint32_t currentIndex;
- 
-  /// freeLock - The list of locks that are allocated and available.
+
+  /// NbShards - The free locks are split by index in shards, each with its
+  /// own spin lock, so that threads inflating at the same time rarely meet.
+  ///
+  static const uint32_t NbShards = 16;
+
+  /// Shard - A list of locks that are allocated and available. Shards are a
+  /// cache line each.
   ///
-  FatLock* freeLock;
+  struct Shard {
+    vmkit::SpinLock lock;
+    FatLock* freeLock;
+    char padding[64 - sizeof(vmkit::SpinLock) - sizeof(FatLock*)];
+  };
+
+  Shard shards[NbShards];
  
-  /// threadLock - Spin lock to protect the currentIndex field.
+  /// threadLock - Spin lock to protect the creation of the table chunks.
   ///
   vmkit::SpinLock threadLock;
   
-  /// allocate - Allocate a FatLock.
+  /// allocate - Allocate a FatLock. Takes it from the cache of the current
+  /// thread, refilled from the shard of the thread, from other shards, or
+  /// with new locks.
   ///
   FatLock* allocate(gc* obj); 
  
-  /// deallocate - Put a lock in the free list lock.
+  /// deallocate - Put a lock in the free list of its shard.
   ///
   void deallocate(FatLock* lock);
 
+  /// flushCache - Give back the free locks cached by a thread.
+  ///
+  void flushCache(LockingThread* th);
+
   /// LockSystem - Default constructor. Initialize the table.
   ///
   LockSystem(vmkit::BumpPtrAllocator& allocator);
 
-  /// getLock - Get a lock from an index in the table.
+  /// getLock - Get a lock from an index in the table. Does not synchronize:
+  /// locks are in the table before their ID is in a header, and stay there.
   ///
   FatLock* getLock(uint32_t index) {
     return LockTable[index >> BitIndex][index & BitMask];
   }
 
   FatLock* getFatLockFromID(word_t ID);
+
+  /// deflateIdleLocks - Change the fat locks that no thread holds, waits on or
+  /// is about to lock back to thin locks, and put them in the free list.
+  /// Also lets revoked types be biased again once their counts decayed.
+  /// Other threads must be stopped.
+  ///
+  void deflateIdleLocks();
+
+  /// scanLocks - Called by the GC once liveness is final. The lock table holds
+  /// its objects weakly: locks of dead objects are freed, once idle, and the
+  /// objects of the other locks are forwarded.
+  ///
+  void scanLocks(word_t closure);
+
+  /// Bias heuristics - Revocations of biases by other threads are counted per
+  /// type. After BulkRebiasThreshold revocations, the bias of an object that
+  /// its owner does not hold moves to the thread that wants it. After
+  /// BulkRevokeThreshold, objects of the type are not biased anymore. Counts
+  /// restart when the last revocation is older than BiasDecayTime.
+  ///
+  static const uint32_t BulkRebiasThreshold = 20;
+  static const uint32_t BulkRevokeThreshold = 40;
+  static const uint64_t BiasDecayTime = 25LL * 1000 * 1000 * 1000;
+
+  /// BiasSlots - Statistics are hashed by virtual table, and types that
+  /// collide share them.
+  ///
+  static const uint32_t BiasSlots = 256;
+
+  enum BiasState {
+    Biasable,
+    Rebias,
+    Revoked
+  };
+
+  struct BiasStats {
+    uint32_t state;
+    uint32_t revocations;
+    uint64_t lastRevocation;
+  };
+
+  BiasStats biasStats[BiasSlots];
+
+  /// profiler - The contention profile of the locks, off by default.
+  ///
+  LockProfiler profiler;
+
+  /// isBiasable - Whether the lock of the object may be biased towards a
+  /// thread.
+  ///
+  bool isBiasable(gc* object);
+
+  /// recordRevocation - Count a revocation of the bias of the object by
+  /// another thread. Returns true if the bias should move to that thread.
+  /// Other threads must be stopped.
+  ///
+  bool recordRevocation(gc* object);
+
+private:
+  /// takeFreeLocks - Move up to count locks of the free list of a shard to
+  /// buffer. Returns how many were moved.
+  ///
+  uint32_t takeFreeLocks(uint32_t shard, FatLock** buffer, uint32_t count);
+
+  /// newLock - Create a free lock at a new index.
+  ///
+  FatLock* newLock();
 };
 
 class ThinLock {
@@ -170,22 +398,42 @@ public:
   // The header of an object that has a thin lock implementation is like the
   // following:
   //
-  //    x      xxx xxxx xxxx        xxxx xxxx xxxx        xxxx xxxx
-  //    ^      ^^^ ^^^^ ^^^^        ^^^^ ^^^^ ^^^^        ^^^^ ^^^^
-  //    1           11                    12                  8
-  // fat lock    thread id       thin lock count + hash     GC bits
+  //    x      xxx xxxx xxxx      x       xxx      xxxx xxxx     xxxx xxxx
+  //    ^      ^^^ ^^^^ ^^^^      ^       ^^^      ^^^^ ^^^^     ^^^^ ^^^^
+  //    1           11            1        3           8             8
+  // fat lock    thread id     biased  thin count     hash        GC bits
+  //
+  // On 64-bit, the biased bit is bit 62, above the thread id, and the thin
+  // lock count keeps 4 bits.
+  //
+  // A biased lock belongs to its thread even when free: its count is the
+  // number of times the thread holds it, and only that thread writes the
+  // header, without atomic operations. Other threads revoke the bias first.
 
   static const uint64_t FatMask = 1LL << (kThreadStart > 0xFFFFFFFFLL ? 61LL : 31LL);
 
   static const uint64_t NonLockBits = HashBits + GCBits;
   static const uint64_t NonLockBitsMask = ((1LL << NonLockBits) - 1LL);
 
-  static const uint64_t ThinCountMask = 0xFFFFFFFFLL & ~(FatMask | kThreadIDMask | NonLockBitsMask);
+  static const uint64_t BiasedMask = 1LL << (kThreadStart > 0xFFFFFFFFLL ? 62LL : NonLockBits + 3);
+
+  static const uint64_t ThinCountMask = 0xFFFFFFFFLL & ~(FatMask | BiasedMask | kThreadIDMask | NonLockBitsMask);
   static const uint64_t ThinCountShift = NonLockBits;
   static const uint64_t ThinCountAdd = 1LL << NonLockBits;
 
-  /// initialise - Initialise the value of the lock.
-  ///
+  /// BiasedLocking - Whether locks are biased towards the first thread that
+  /// takes them. Read by the compiler, so set it before compiling methods.
+  static bool BiasedLocking;
+
+  /// revokeBias - Make the lock of the object a thin lock again, held by the
+  /// owner of the bias as many times as the bias was. Unless the current
+  /// thread owns the bias, other threads are stopped. If acquiring, the
+  /// revocation is counted against the type of the object, and the bias may
+  /// move to the current thread instead.
+  static void revokeBias(gc* object, LockSystem& table, bool acquiring);
+
+  /// removeFatLock - Change the lock of the object of an idle fat lock back
+  /// to a thin lock. Other threads must be stopped.
   static void removeFatLock(FatLock* fatLock, LockSystem& table);
 
   /// overflowThinlock - Change the lock of this object to a fat lock because
@@ -196,9 +444,15 @@ public:
   /// may be in a thin lock or fat lock state.
   static FatLock* changeToFatlock(gc* object, LockSystem& table);
 
-  /// acquire - Acquire the lock.
+  /// acquire - Acquire the lock. If another thread holds the thin lock, spin
+  /// for as long as spinning on this lock succeeded before, then park and
+  /// inflate the lock so that later contenders block on the fat lock.
   static void acquire(gc* object, LockSystem& table);
 
+  /// tryAcquire - Acquire the lock if no other thread holds it, without
+  /// spinning or blocking. Returns whether the lock was acquired.
+  static bool tryAcquire(gc* object, LockSystem& table);
+
   /// release - Release the lock.
   static void release(gc* object, LockSystem& table, vmkit::Thread* ownerThread = NULL);
 
@@ -136,6 +136,10 @@ namespace vmkit {
 
 	template <class T_THREAD> class ReferenceThread : public T_THREAD {
 	public:
+	  virtual vmkit::ThreadAffinity::Role getAffinityRole() {
+	    return vmkit::ThreadAffinity::Reference;
+	  }
+
 	  /// WeakReferencesQueue - The queue of weak references.
 	  ///
 	  ReferenceQueue WeakReferencesQueue;
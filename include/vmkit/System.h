@@ -13,10 +13,17 @@
 #include <csetjmp>
 #include <cstring>
 #include <dlfcn.h>
+#include <sched.h>
 #include <signal.h>
 #include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #if defined(__linux__) || defined(__FreeBSD__)
 #define LINUX_OS 1
 #elif defined(__APPLE__)
@@ -63,13 +70,17 @@ const int kWordSizeLog2 = kWordSize == 4 ? 2 : 3;
 #if ARCH_X64
 const word_t kThreadStart   = 0x0000000110000000LL;
 const word_t kThreadIDMask  = 0xFFFFFFFFFFF00000LL;
-const word_t kVmkitThreadMask = 0xFFFFFFFFF0000000LL;
+const word_t kThreadRegionSize = 0x0000000100000000LL;
 #else
 const word_t kThreadStart   = 0x10000000;
 const word_t kThreadIDMask  = 0x7FF00000;
-const word_t kVmkitThreadMask = 0xF0000000;
+const word_t kThreadRegionSize = 0x10000000;
 #endif
 
+// Each thread owns a slot of kThreadSlotSize bytes in the thread region. The
+// slot size is implied by kThreadIDMask and must not be changed on its own.
+const word_t kThreadSlotSize = 0x100000;
+
 #if MACOS_OS
   #define LONGJMP _longjmp
   #define SETJMP _setjmp
@@ -133,9 +144,14 @@ public:
     return kThreadIDMask;
   }
 
-  // Apply this mask to verify that the current thread was created by vmkit.
-  static word_t GetVmkitThreadMask() {
-    return kVmkitThreadMask;
+  // Size of the memory range reserved for thread stacks.
+  static word_t GetThreadRegionSize() {
+    return kThreadRegionSize;
+  }
+
+  // Size of the memory range given to each thread, stack included.
+  static word_t GetThreadSlotSize() {
+    return kThreadSlotSize;
   }
 
   // Get the memory start of thread stack addresses.
@@ -232,12 +248,52 @@ public:
     return sysconf(_SC_NPROCESSORS_ONLN);
   }
 
+  // Monotonic time in nanoseconds, for measuring intervals.
+  static uint64_t GetNanoTime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  // Tell the processor the caller is in a spin-wait loop, so that it saves
+  // power and leaves resources to its sibling hardware thread.
+  static void Pause() {
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#else
+    __sync_synchronize();
+#endif
+  }
+
   static void Exit(int value) {
     _exit(value);
   }
 
+  // Block while *addr is equal to val, or until timeout (a relative time) has
+  // elapsed. May return spuriously, callers must check their condition again.
+  static void FutexWait(volatile int32_t* addr, int32_t val,
+                        const struct timespec* timeout = NULL) {
+#if defined(__linux__)
+    syscall(SYS_futex, (int32_t*)addr, FUTEX_WAIT_PRIVATE, val, timeout,
+            NULL, 0);
+#else
+    if (*addr == val) sched_yield();
+#endif
+  }
+
+  // Wake up to count threads blocked in FutexWait on addr.
+  static void FutexWake(volatile int32_t* addr, int32_t count) {
+#if defined(__linux__)
+    syscall(SYS_futex, (int32_t*)addr, FUTEX_WAKE_PRIVATE, count, NULL,
+            NULL, 0);
+#endif
+  }
+
   static bool SupportsHardwareNullCheck();
   static bool SupportsHardwareStackOverflow();
+  static bool SupportsHardwareSafepointPoll();
 };
 
 }
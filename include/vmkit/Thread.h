@@ -12,6 +12,7 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <stdlib.h>
 
 #include "debug.h"
@@ -23,6 +24,7 @@
 namespace vmkit {
 
 class FrameInfo;
+class LockingThread;
 class VirtualMachine;
 
 /// CircularBase - This class represents a circular list. Classes that extend
@@ -108,6 +110,56 @@ public:
 
 
 class ExceptionBuffer;
+class Thread;
+
+/// ThreadAffinity - The CPUs threads run on, depending on their role. Roles
+/// without CPUs float freely. Mutators may also be pinned one per CPU, with
+/// the CPUs that no other role uses ordered by a placement policy.
+///
+class ThreadAffinity {
+public:
+  enum Role {
+    Mutator = 0,
+    Collector,
+    Finalizer,
+    Reference,
+    NbRoles
+  };
+
+  enum Placement {
+    Float = 0,  // Mutators run on any of their CPUs.
+    Compact,    // Fill a package before using the next one.
+    Scatter     // Go round-robin over packages.
+  };
+
+  /// parse - Parse a list such as "gc=0-3,finalizer=4,mutator=scatter".
+  /// Returns false if the list is malformed.
+  ///
+  static bool parse(const char* options);
+
+  /// apply - Move the current thread to the CPUs of the role.
+  ///
+  static void apply(Role role);
+
+  /// enterCollector - Move the current thread to the collector CPUs until
+  /// leaveCollector. Used by the thread that initiates a collection.
+  ///
+  static void enterCollector();
+  static void leaveCollector();
+};
+
+/// HandshakeClosure - An operation run on behalf of a single thread while the
+/// thread is stopped at a safe point. See Thread::handshake.
+///
+class HandshakeClosure {
+public:
+  virtual ~HandshakeClosure() {}
+
+  /// doThread - Run the operation. The thread may be the current thread, or
+  /// a thread stopped in uncooperative code whose stack can be walked.
+  ///
+  virtual void doThread(Thread* th) = 0;
+};
 
 /// Thread - This class is the base of custom virtual machines' Thread classes.
 /// It provides static functions to manage threads. An instance of this class
@@ -117,6 +169,9 @@ public:
   Thread() {
     lastExceptionBuffer = 0;
     lastKnownFrame = 0;
+    memset(safepointHistogram, 0, sizeof(safepointHistogram));
+    handshakeOp = 0;
+    handshakeState = kHandshakeNone;
   }
 
   /// yield - Yield the processor to another thread.
@@ -138,7 +193,28 @@ public:
   /// start - Start the execution of a thread.
   ///
   virtual int start(void (*fct)(vmkit::Thread*));
-  
+
+  /// attach - Make the current native thread, which VMKit did not create,
+  /// run as this thread, allocated with AttachedSlot. The native thread
+  /// keeps its own stack, where get finds the thread with a thread-local
+  /// lookup, and runs code that walks the stack by masking the stack
+  /// pointer, such as compiled Java code, through callOnStack. Outside of
+  /// the VM, the thread is in uncooperative code with no frame to scan.
+  /// Returns false if the platform can not switch stacks.
+  ///
+  virtual bool attach();
+
+  /// detach - Remove the attached current thread from the VM. The thread
+  /// must be outside of the VM. The Thread object must not be used after.
+  ///
+  virtual void detach();
+
+  /// callOnStack - Call fct with arg on the stack of this thread's slot.
+  /// Used by attached threads running off their stack. Exceptions thrown by
+  /// fct are caught on that stack and stay pending.
+  ///
+  void callOnStack(void (*fct)(void*), void* arg);
+
   uint64_t getThreadID() {
     return (uint64_t)this;
   }
@@ -172,9 +248,28 @@ public:
   /// get - Get the thread specific data of the current thread.
   ///
   static Thread* get() {
-    return (Thread*)(System::GetCallerAddress() & System::GetThreadIDMask());
+    Thread* th =
+      (Thread*)(System::GetCallerAddress() & System::GetThreadIDMask());
+    if (th->isVmkitThread()) return th;
+    // Attached native threads run on a stack outside of the thread region.
+    Thread* attached = getAttached();
+    return attached ? attached : th;
   }
-  
+
+  /// getAttached - Get the thread the current native thread attached as, or
+  /// NULL. Uses a thread-local lookup, so it is slower than get.
+  ///
+  static Thread* getAttached();
+
+  /// runsOffStack - Does the current thread run on a stack outside of the
+  /// thread region? Attached threads do, unless they run Java code.
+  ///
+  static bool runsOffStack() {
+    Thread* th =
+      (Thread*)(System::GetCallerAddress() & System::GetThreadIDMask());
+    return !th->isVmkitThread();
+  }
+
 private:
   
   /// lastSP - If the thread is running native code that can not be
@@ -202,6 +297,17 @@ public:
   /// a tracer.
   ///
   virtual void tracer(word_t closure) {}
+
+  /// getAffinityRole - The role that decides the CPUs of this thread.
+  ///
+  virtual ThreadAffinity::Role getAffinityRole() {
+    return ThreadAffinity::Mutator;
+  }
+
+  /// getLockingThread - The object locking state of this thread, or NULL if
+  /// the thread does not lock objects.
+  ///
+  virtual LockingThread* getLockingThread() { return NULL; }
   void scanStack(word_t closure);
   
   word_t getLastSP() { return lastSP; }
@@ -224,7 +330,7 @@ public:
 
   bool isVmkitThread() const {
     if (!baseAddr) return false;
-    else return (((word_t)this) & System::GetVmkitThreadMask()) == baseAddr;
+    else return ((word_t)this - baseAddr) < System::GetThreadRegionSize();
   }
 
   /// baseAddr - The base address for all threads.
@@ -242,16 +348,37 @@ public:
     return (System::GetCallerAddress() & StackOverflowMask) == 0;
   }
 
+  /// SlotUse - What runs the thread of a new Thread object.
+  ///
+  enum SlotUse {
+    /// start runs the thread, on a parked native thread if there is one.
+    StartedSlot,
+    /// The current native thread runs it with attach. Its slot has no
+    /// native thread of its own.
+    AttachedSlot
+  };
+
   /// operator new - Allocate the Thread object as well as the stack for this
   /// Thread. The thread object is inlined in the stack.
   ///
-  void* operator new(size_t sz);
+  void* operator new(size_t sz, SlotUse use);
+  void* operator new(size_t sz) { return operator new(sz, StartedSlot); }
   void operator delete(void* th) { UNREACHABLE(); }
   
   /// releaseThread - Free the stack so that another thread can use it.
   ///
   static void releaseThread(vmkit::Thread* th);
 
+  /// setDefaultStackSize - Set the size of the stack given to threads
+  /// allocated from now on. The size is rounded to pages and clamped to what
+  /// fits in a thread slot. Returns the size actually used.
+  ///
+  static word_t setDefaultStackSize(word_t size);
+
+  /// getDefaultStackSize - Get the size of the stack given to new threads.
+  ///
+  static word_t getDefaultStackSize();
+
   /// routine - The function to invoke when the thread starts.
   ///
   void (*routine)(vmkit::Thread*);
@@ -276,6 +403,44 @@ public:
   ///
   ExceptionBuffer* lastExceptionBuffer;
 
+  /// kSafepointBuckets - Number of buckets in the time-to-safepoint
+  /// histogram. Bucket i counts the rendezvous this thread joined in less
+  /// than 10^(i+1) microseconds, the last bucket counts all slower ones.
+  ///
+  static const uint32_t kSafepointBuckets = 6;
+
+  /// safepointHistogram - How long this thread took to reach a safe point,
+  /// over all rendezvous. Only maintained when the safepoint log is on.
+  ///
+  uint32_t safepointHistogram[kSafepointBuckets];
+
+  /// Handshake states. A requester moves a thread from None to Pending.
+  /// Whoever runs the operation moves it to Running then Done, and the
+  /// requester moves it back to None once the thread may resume.
+  ///
+  enum {
+    kHandshakeNone = 0,
+    kHandshakePending,
+    kHandshakeRunning,
+    kHandshakeDone
+  };
+
+  /// handshakeOp - The operation of the pending handshake, if any.
+  ///
+  HandshakeClosure* volatile handshakeOp;
+
+  /// handshakeState - Where the handshake of this thread is. Threads futex
+  /// wait on this word.
+  ///
+  volatile int32_t handshakeState;
+
+  /// handshake - Run the closure on behalf of the target thread, once the
+  /// target reaches a safe point or if it is in uncooperative code. Other
+  /// threads keep running. Returns after the closure ran. The target must be
+  /// alive.
+  ///
+  static void handshake(Thread* target, HandshakeClosure* closure);
+
   void internalThrowException();
 
   void startKnownFrame(KnownFrame& F) __attribute__ ((noinline));
@@ -283,18 +448,30 @@ public:
   void startUnknownFrame(KnownFrame& F) __attribute__ ((noinline));
   void endUnknownFrame();
 
-  word_t GetAlternativeStackEnd() {
+  /// GetPollingPage - The page compiled code of this thread reads at safe
+  /// points, when polling pages are enabled. It follows the page of the
+  /// Thread object, and is protected while the thread must yield.
+  ///
+  word_t GetPollingPage() {
     return (word_t)this + System::GetPageSize();
   }
 
+  word_t GetAlternativeStackEnd() {
+    return GetPollingPage() + System::GetPageSize();
+  }
+
   word_t GetAlternativeStackStart() {
     return GetAlternativeStackEnd() + System::GetAlternativeStackSize();
   }
 
+  /// GetStackBottom - The lowest usable address of the stack. Everything
+  /// between the alternative stack and this address is protected.
+  ///
+  word_t GetStackBottom();
+
   bool IsStackOverflowAddr(word_t addr) {
     word_t stackOverflowCheck = GetAlternativeStackStart();
-    return addr > stackOverflowCheck &&
-      addr <= stackOverflowCheck + System::GetPageSize();
+    return addr > stackOverflowCheck && addr < GetStackBottom();
   }
 
   virtual void throwNullPointerException(word_t methodIP);
@@ -16,6 +16,7 @@
 
 #include "vmkit/Allocator.h"
 #include "vmkit/CollectionRV.h"
+#include "vmkit/Cond.h"
 #include "vmkit/Locks.h"
 #include "vmkit/GC.h"
 
@@ -151,6 +152,10 @@ public:
   /// waitForExit - Wait until the virtual machine stops its execution.
   void waitForExit();
 
+  /// dumpLockProfile - Write the lock contention profile, if it is on. Called
+  /// on exit and on SIGQUIT.
+  virtual void dumpLockProfile() {}
+
 //===----------------------------------------------------------------------===//
 // (2) GC-related methods.
 //===----------------------------------------------------------------------===//
@@ -162,6 +167,11 @@ public:
   /// endCollection - Code after running a GC.
   ///
   virtual void endCollection() {}
+
+  /// deflateIdleLocks - Give back the object locks no thread uses. Called by
+  /// the GC once all threads are stopped, before tracing.
+  ///
+  virtual void deflateIdleLocks() {}
   
   /// scanWeakReferencesQueue - Scan all weak references. Called by the GC
   /// before scanning the finalization queue.
@@ -196,6 +206,17 @@ public:
   ///
   virtual void tracer(word_t closure) {}
 
+  /// getNbRootPackets - The number of packets the roots of this virtual
+  /// machine are split in. Collectors trace packets in parallel.
+  ///
+  virtual uint32_t getNbRootPackets() { return 1; }
+
+  /// traceRootPacket - Trace one packet of this virtual machine's roots.
+  ///
+  virtual void traceRootPacket(uint32_t packet, word_t closure) {
+    tracer(closure);
+  }
+
   /// traceObject - Method called during GC to trace live objects graph.
   ///
   virtual void traceObject(gc* object, word_t closure) = 0;
@@ -244,7 +265,8 @@ public:
     FunctionsCache.removeFrameInfos(owner);
   }
 
-  virtual void printMethod(FrameInfo* FI, word_t ip, word_t addr) = 0;
+  virtual void printMethod(FrameInfo* FI, word_t ip, word_t addr,
+                           FILE* out = stderr) = 0;
   
 //===----------------------------------------------------------------------===//
 // (4) Launch-related methods.
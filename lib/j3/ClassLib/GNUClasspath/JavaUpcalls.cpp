@@ -54,6 +54,7 @@ JavaMethod* Classpath::uncaughtException;
 Class*      Classpath::inheritableThreadLocal;
 
 JavaMethod* Classpath::runVMThread;
+JavaMethod* Classpath::threadDie;
 JavaMethod* Classpath::setContextClassLoader;
 JavaMethod* Classpath::getSystemClassLoader;
 Class*      Classpath::newString;
@@ -249,7 +250,8 @@ JavaMethod* Classpath::EnqueueReference;
 Class*      Classpath::newReference;
 
 void Classpath::CreateJavaThread(Jnjvm* vm, JavaThread* myth,
-                                 const char* thName, JavaObject* Group) {
+                                 const char* thName, JavaObject* Group,
+                                 bool isDaemon) {
   JavaObjectVMThread* vmth = NULL;
   JavaObject* th = NULL;
   JavaObject* name = NULL;
@@ -264,7 +266,7 @@ void Classpath::CreateJavaThread(Jnjvm* vm, JavaThread* myth,
 
   name = vm->asciizToStr(thName);
 
-  initThread->invokeIntSpecial(vm, newThread, th, &vmth, &name, 1, 0); 
+  initThread->invokeIntSpecial(vm, newThread, th, &vmth, &name, 1, isDaemon);
   vmThread->setInstanceObjectField(th, vmth);
   assocThread->setInstanceObjectField(vmth, th);
   running->setInstanceInt8Field(vmth, (uint32)1);
@@ -276,6 +278,30 @@ void Classpath::CreateJavaThread(Jnjvm* vm, JavaThread* myth,
   finaliseCreateInitialThread->invokeIntStatic(vm, inheritableThreadLocal, &th);
 }
 
+void Classpath::AttachJavaThread(Jnjvm* vm, JavaThread* myth,
+                                 const char* thName, JavaObject* Group,
+                                 bool isDaemon) {
+  llvm_gcroot(Group, 0);
+  if (Group == NULL) Group = rootGroup->getStaticObjectField();
+  CreateJavaThread(vm, myth, thName, Group, isDaemon);
+}
+
+void Classpath::DetachJavaThread(Jnjvm* vm, JavaThread* myth) {
+  JavaObject* javaThread = myth->javaThread;
+  JavaObject* vmth = myth->vmThread;
+  llvm_gcroot(javaThread, 0);
+  llvm_gcroot(vmth, 0);
+
+  // Remove the thread from its group, as VMThread.run does.
+  threadDie->invokeIntSpecial(vm, newThread, javaThread);
+
+  JavaObject::acquire(vmth);
+  running->setInstanceInt8Field(vmth, (uint32)0);
+  // Release the threads waiting to join this one.
+  JavaObject::notifyAll(vmth);
+  JavaObject::release(vmth);
+}
+
 void Classpath::InitializeThreading(Jnjvm* vm) {
 
   JavaObject* RG = 0;
@@ -957,6 +983,9 @@ void Classpath::initialiseClasspath(JnjvmClassLoader* loader) {
   runVMThread = 
     UPCALL_METHOD(loader, "java/lang/VMThread", "run", "()V", ACC_VIRTUAL);
 
+  threadDie =
+    UPCALL_METHOD(loader, "java/lang/Thread", "die", "()V", ACC_VIRTUAL);
+
 
   groupAddThread = 
     UPCALL_METHOD(loader, "java/lang/ThreadGroup", "addThread",
@@ -157,6 +157,7 @@ public:
   ISOLATE_STATIC JavaMethod* initThread;
   ISOLATE_STATIC JavaMethod* initVMThread;
   ISOLATE_STATIC JavaMethod* runVMThread;
+  ISOLATE_STATIC JavaMethod* threadDie;
   ISOLATE_STATIC JavaMethod* groupAddThread;
   ISOLATE_STATIC JavaField* threadName;
   ISOLATE_STATIC JavaField* groupName;
@@ -292,10 +293,21 @@ public:
 
 private:
   ISOLATE_STATIC void CreateJavaThread(Jnjvm* vm, JavaThread* myth,
-                                       const char* name, JavaObject* Group);
+                                       const char* name, JavaObject* Group,
+                                       bool isDaemon = false);
 
 public:
   ISOLATE_STATIC void InitializeThreading(Jnjvm* vm);
+
+  /// AttachJavaThread - Create the java.lang.Thread of a native thread that
+  /// attached to the VM. Threads with no group go in the root group.
+  ISOLATE_STATIC void AttachJavaThread(Jnjvm* vm, JavaThread* myth,
+                                       const char* name, JavaObject* Group,
+                                       bool isDaemon);
+
+  /// DetachJavaThread - Remove the thread from its group and wake up the
+  /// joiners of a thread that is done running Java code.
+  ISOLATE_STATIC void DetachJavaThread(Jnjvm* vm, JavaThread* myth);
   ISOLATE_STATIC void InitializeSystem(Jnjvm* vm);
 };
 
@@ -259,7 +259,8 @@ const char * OpenJDKBootPath =
   ":" VMKitOpenJDKZip ;
 
 void Classpath::CreateJavaThread(Jnjvm* vm, JavaThread* myth,
-                                 const char* thName, JavaObject* Group) {
+                                 const char* thName, JavaObject* Group,
+                                 bool isDaemon) {
   JavaObject* th = NULL;
   JavaObject* name = NULL;
   JavaObject* sleep = NULL;
@@ -278,7 +279,7 @@ void Classpath::CreateJavaThread(Jnjvm* vm, JavaThread* myth,
 
   // Initialize the values
   priority->setInstanceInt32Field(th, (uint32)5);
-  daemon->setInstanceInt8Field(th, (uint32)false);
+  daemon->setInstanceInt8Field(th, (uint32)isDaemon);
 
   // call Thread(ThreadGroup,String) constructor
   initThread->invokeIntSpecial(vm, newThread, th, &Group, &name);
@@ -288,6 +289,32 @@ void Classpath::CreateJavaThread(Jnjvm* vm, JavaThread* myth,
   eetop->setInstanceLongField(th, (long)myth);
 }
 
+void Classpath::AttachJavaThread(Jnjvm* vm, JavaThread* myth,
+                                 const char* thName, JavaObject* Group,
+                                 bool isDaemon) {
+  llvm_gcroot(Group, 0);
+  if (Group == NULL) {
+    Group = group->getInstanceObjectField(
+        vm->getFinalizerThread()->javaThread);
+  }
+  CreateJavaThread(vm, myth, thName, Group, isDaemon);
+}
+
+void Classpath::DetachJavaThread(Jnjvm* vm, JavaThread* myth) {
+  JavaObject* javaThread = myth->javaThread;
+  llvm_gcroot(javaThread, 0);
+
+  UserClass* thClass = JavaObject::getClass(javaThread)->asClass();
+  threadExit->invokeIntVirtual(vm, thClass, javaThread);
+
+  JavaObject::acquire(javaThread);
+  // Indicate that the thread is done by clearing the eetop field.
+  eetop->setInstanceLongField(javaThread, 0);
+  // Notify all waiting threads
+  JavaObject::notifyAll(javaThread);
+  JavaObject::release(javaThread);
+}
+
 void Classpath::InitializeThreading(Jnjvm* vm) {
 
   JavaObject* RG = 0;
@@ -292,10 +292,21 @@ public:
 
 private:
   ISOLATE_STATIC void CreateJavaThread(Jnjvm* vm, JavaThread* myth,
-                                       const char* name, JavaObject* Group);
+                                       const char* name, JavaObject* Group,
+                                       bool isDaemon = false);
 
 public:
   ISOLATE_STATIC void InitializeThreading(Jnjvm* vm);
+
+  /// AttachJavaThread - Create the java.lang.Thread of a native thread that
+  /// attached to the VM. Threads with no group go in the system group.
+  ISOLATE_STATIC void AttachJavaThread(Jnjvm* vm, JavaThread* myth,
+                                       const char* name, JavaObject* Group,
+                                       bool isDaemon);
+
+  /// DetachJavaThread - Call Thread.exit() and wake up the joiners of a
+  /// thread that is done running Java code.
+  ISOLATE_STATIC void DetachJavaThread(Jnjvm* vm, JavaThread* myth);
   ISOLATE_STATIC void InitializeSystem(Jnjvm* vm);
 };
 
@@ -22,6 +22,7 @@
 
 #include <cstddef>
 #include <map>
+#include <vector>
 
 #include "VmkitGC.h"
 
@@ -114,6 +115,16 @@ bool EscapeAnalysis::runOnFunction(Function& F) {
 
 
 
+/// isMonitorCall - Whether the call or invoke goes to the runtime to acquire
+/// or release the lock of an object.
+static bool isMonitorCall(Instruction* I) {
+  CallSite CS(I);
+  Function* F = CS.getCalledFunction();
+  if (F == NULL) return false;
+  return F->getName() == "j3JavaObjectAquire" ||
+         F->getName() == "j3JavaObjectRelease";
+}
+
 static bool escapes(Value* Ins, std::map<Instruction*, bool>& visited) {
   for (Value::use_iterator I = Ins->use_begin(), E = Ins->use_end(); 
        I != E; ++I) {
@@ -121,6 +132,9 @@ static bool escapes(Value* Ins, std::map<Instruction*, bool>& visited) {
       if (II->getOpcode() == Instruction::Call || 
           II->getOpcode() == Instruction::Invoke) {
         
+        // Locking only touches the header of the object.
+        if (isMonitorCall(II)) continue;
+
         CallSite CS(II);
         if (!CS.onlyReadsMemory()) return true;
         
@@ -169,6 +183,49 @@ static bool escapes(Value* Ins, std::map<Instruction*, bool>& visited) {
   return false;
 }
 
+/// findLockAccesses - Collect the monitor calls on the object. Monitor
+/// operations are still calls here: InlineMonitors runs later.
+static void findLockAccesses(Value* Ins, std::vector<Instruction*>& accesses,
+                             std::map<Instruction*, bool>& visited) {
+  for (Value::use_iterator I = Ins->use_begin(), E = Ins->use_end();
+       I != E; ++I) {
+    Instruction* II = dyn_cast<Instruction>(*I);
+    if (II == NULL) continue;
+    if (II->getOpcode() == Instruction::Call ||
+        II->getOpcode() == Instruction::Invoke) {
+      if (isMonitorCall(II)) accesses.push_back(II);
+    } else if (isa<BitCastInst>(II) ||
+               (isa<LoadInst>(II) && isa<AllocaInst>(Ins))) {
+      findLockAccesses(II, accesses, visited);
+    } else if (StoreInst* SI = dyn_cast<StoreInst>(II)) {
+      if (AllocaInst* AI = dyn_cast<AllocaInst>(SI->getOperand(1))) {
+        if (!visited[AI]) {
+          visited[AI] = true;
+          findLockAccesses(AI, accesses, visited);
+        }
+      }
+    } else if (isa<PHINode>(II)) {
+      if (!visited[II]) {
+        visited[II] = true;
+        findLockAccesses(II, accesses, visited);
+      }
+    }
+  }
+}
+
+/// elideLocks - Remove the monitor calls on an object that no other thread
+/// can see.
+static void elideLocks(std::vector<Instruction*>& accesses) {
+  for (std::vector<Instruction*>::iterator I = accesses.begin(),
+       E = accesses.end(); I != E; ++I) {
+    Instruction* II = *I;
+    if (InvokeInst* CI = dyn_cast<InvokeInst>(II)) {
+      BranchInst::Create(CI->getNormalDest(), CI);
+    }
+    II->eraseFromParent();
+  }
+}
+
 bool EscapeAnalysis::processMalloc(Instruction* I, Value* Size, Value* VT,
                                    Loop* CurLoop) {
   Instruction* Alloc = I;
@@ -211,6 +268,12 @@ bool EscapeAnalysis::processMalloc(Instruction* I, Value* Size, Value* VT,
     std::map<Instruction*, bool> visited;
     bool esc = escapes(Alloc, visited);
     if (!esc) {
+      // The object does not escape, so it is never locked by another
+      // thread. Remove its locking.
+      std::vector<Instruction*> accesses;
+      visited.clear();
+      findLockAccesses(Alloc, accesses, visited);
+      elideLocks(accesses);
 
       if (CurLoop) {
         // The object does not escape and is only used in the loop where it
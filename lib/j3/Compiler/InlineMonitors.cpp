@@ -0,0 +1,83 @@
+//===------ InlineMonitors.cpp - Inline the fast path of Java locks -------===//
+//
+//                            The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
+
+#include <vector>
+
+#include "JavaClass.h"
+#include "JavaJIT.h"
+#include "j3/JavaLLVMCompiler.h"
+#include "j3/J3Intrinsics.h"
+
+using namespace llvm;
+
+namespace j3 {
+
+/// InlineMonitors - Replace the calls that the JIT emits to acquire and
+/// release locks with the inline fast path of thin locks.
+///
+class InlineMonitors : public FunctionPass {
+public:
+  static char ID;
+  JavaLLVMCompiler* TheCompiler;
+  InlineMonitors(JavaLLVMCompiler* Compiler) : FunctionPass(ID),
+    TheCompiler(Compiler) { }
+
+  const char* getPassName() const { return "Inline Java locks"; }
+
+  virtual bool runOnFunction(Function &F);
+};
+char InlineMonitors::ID = 0;
+
+bool InlineMonitors::runOnFunction(Function& F) {
+  J3Intrinsics* intrinsics = TheCompiler->getIntrinsics();
+  JavaMethod* meth = TheCompiler->getJavaMethod(F);
+  assert(meth && "Method not registered");
+
+  // The fast paths call the same functions on their slow path, so collect
+  // the calls first.
+  std::vector<CallInst*> calls;
+  for (Function::iterator BI = F.begin(), BE = F.end(); BI != BE; BI++) {
+    for (BasicBlock::iterator II = BI->begin(), IE = BI->end(); II != IE;
+         II++) {
+      if (CallInst* CI = dyn_cast<CallInst>(II)) {
+        Value* Callee = CI->getCalledValue();
+        if (Callee == intrinsics->AquireObjectFunction ||
+            Callee == intrinsics->ReleaseObjectFunction) {
+          calls.push_back(CI);
+        }
+      }
+    }
+  }
+  if (calls.empty()) return false;
+
+  JavaJIT jit(TheCompiler, meth, &F, NULL);
+  for (std::vector<CallInst*>::iterator I = calls.begin(), E = calls.end();
+       I != E; ++I) {
+    CallInst* CI = *I;
+    if (CI->getCalledValue() == intrinsics->AquireObjectFunction) {
+      jit.lowerMonitorEnter(CI);
+    } else {
+      jit.lowerMonitorExit(CI);
+    }
+  }
+  return true;
+}
+
+
+FunctionPass* createInlineMonitorsPass(JavaLLVMCompiler* Compiler) {
+  return new InlineMonitors(Compiler);
+}
+
+}
@@ -79,6 +79,21 @@ bool JavaJIT::needsInitialisationCheck(Class* cl) {
 
 void JavaJIT::checkYieldPoint() {
   if (!TheCompiler->useCooperativeGC()) return;
+
+  if (Constant* Offset = TheCompiler->getSafepointPollOffset()) {
+    // The collector protects the page of the thread to stop it. Like hardware
+    // null checks, the load is a safe point recorded at column 1.
+    Value* Page = new PtrToIntInst(getMutatorThreadPtr(),
+                                   intrinsics->pointerSizeType, "",
+                                   currentBlock);
+    Page = BinaryOperator::CreateAdd(Page, Offset, "", currentBlock);
+    Page = new IntToPtrInst(Page, intrinsics->ptrType, "pollingPage",
+                            currentBlock);
+    Instruction* Poll = new LoadInst(Page, "safepointPoll", true, currentBlock);
+    Poll->setDebugLoc(DebugLoc::get(currentBytecodeIndex, 1, DbgSubprogram));
+    return;
+  }
+
   Value* YieldPtr = getDoYieldPtr(getMutatorThreadPtr());
 
   Value* Yield = new LoadInst(YieldPtr, "yield", currentBlock);
@@ -94,9 +109,29 @@ void JavaJIT::checkYieldPoint() {
   currentBlock = continueBlock;
 }
 
+void JavaJIT::checkStripMinedYieldPoint(uint16 local) {
+  if (!TheCompiler->useCooperativeGC()) return;
+
+  Value* Counter = new LoadInst(intLocals[local], "", currentBlock);
+  Value* Strip = BinaryOperator::CreateAnd(
+      Counter, ConstantInt::get(Type::getInt32Ty(*llvmContext),
+                                StripMineLength - 1), "", currentBlock);
+  Value* Cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, Strip,
+                            intrinsics->constantZero, "");
+
+  BasicBlock* continueBlock = createBasicBlock("afterStripMinedPoll");
+  BasicBlock* pollBlock = createBasicBlock("stripMinedPoll");
+  BranchInst::Create(pollBlock, continueBlock, Cmp, currentBlock);
+
+  currentBlock = pollBlock;
+  checkYieldPoint();
+  BranchInst::Create(continueBlock, currentBlock);
+
+  currentBlock = continueBlock;
+}
+
 bool JavaJIT::canBeInlined(JavaMethod* meth, bool customizing) {
   if (inlineMethods[meth]) return false;
-  if (isSynchro(meth->access)) return false;
   if (isNative(meth->access)) return false;
 
   JavaAttribute* codeAtt = meth->lookupAttribute(JavaAttribute::codeAttribute);
@@ -196,6 +231,13 @@ void JavaJIT::invokeVirtual(uint16 index) {
   FunctionType::param_iterator it  = virtualType->param_end();
   llvm::Type* retType = virtualType->getReturnType();
 
+  if (meth != NULL && isUnsafeMonitorEnter(meth)) {
+    makeArgs(it, index, args, signature->nbArguments + 1);
+    if (!thisReference) JITVerifyNull(args[0]);
+    lowerUnsafeMonitorEnter(args);
+    return;
+  }
+
   bool needsInit = false;
   if (canBeDirect && canBeInlined(meth, customized)) {
     makeArgs(it, index, args, signature->nbArguments + 1);
@@ -657,21 +699,151 @@ llvm::Value* JavaJIT::objectToHeader(Value* obj) {
 	return new IntToPtrInst(obj, intrinsics->ObjectHeaderType, "objectHeader", currentBlock);
 }
 
+Value* JavaJIT::isBiasable(Value* obj, Constant* States) {
+  // Same hash of the virtual table as LockSystem::isBiasable.
+  Value* VT = CallInst::Create(intrinsics->GetVTFunction, obj, "",
+                               currentBlock);
+  VT = new PtrToIntInst(VT, intrinsics->pointerSizeType, "", currentBlock);
+  Value* slot = BinaryOperator::CreateXor(
+      BinaryOperator::CreateLShr(
+          VT, ConstantInt::get(intrinsics->pointerSizeType, 4), "",
+          currentBlock),
+      BinaryOperator::CreateLShr(
+          VT, ConstantInt::get(intrinsics->pointerSizeType, 12), "",
+          currentBlock),
+      "", currentBlock);
+  slot = BinaryOperator::CreateAnd(
+      slot, ConstantInt::get(intrinsics->pointerSizeType,
+                             vmkit::LockSystem::BiasSlots - 1),
+      "", currentBlock);
+  slot = BinaryOperator::CreateMul(
+      slot, ConstantInt::get(intrinsics->pointerSizeType,
+                             sizeof(vmkit::LockSystem::BiasStats)),
+      "", currentBlock);
+  Value* statePtr = new PtrToIntInst(States, intrinsics->pointerSizeType, "",
+                                     currentBlock);
+  statePtr = BinaryOperator::CreateAdd(statePtr, slot, "", currentBlock);
+  statePtr = new IntToPtrInst(statePtr, Type::getInt32PtrTy(*llvmContext),
+                              "", currentBlock);
+  Value* state = new LoadInst(statePtr, "", currentBlock);
+  return new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, state,
+                      ConstantInt::get(Type::getInt32Ty(*llvmContext),
+                                       vmkit::LockSystem::Revoked), "");
+}
+
 void JavaJIT::monitorEnter(Value* obj) {
-  Value* lockPtr = objectToHeader(obj);
+  // Kept as a call until the InlineMonitors pass, so that passes see monitor
+  // regions.
+  CallInst::Create(intrinsics->AquireObjectFunction, obj, "", currentBlock);
+}
 
-  Value* lock = new LoadInst(lockPtr, "", currentBlock);
+void JavaJIT::monitorExit(Value* obj) {
+  CallInst::Create(intrinsics->ReleaseObjectFunction, obj, "", currentBlock);
+}
 
-  Value* NonLockBitsMask = ConstantInt::get(intrinsics->pointerSizeType,
-                                            vmkit::ThinLock::NonLockBitsMask);
+void JavaJIT::lowerMonitorEnter(CallInst* CI) {
+  BasicBlock* Cur = CI->getParent();
+  BasicBlock* Next = Cur->splitBasicBlock(CI, "afterMonitorEnter");
+  Cur->getTerminator()->eraseFromParent();
+  currentBlock = Cur;
+  Value* obj = CI->getArgOperand(0);
+  CI->eraseFromParent();
+  inlineMonitorEnter(obj);
+  BranchInst::Create(Next, currentBlock);
+}
 
-  lock = BinaryOperator::CreateAnd(lock, NonLockBitsMask, "", currentBlock);
+void JavaJIT::lowerMonitorExit(CallInst* CI) {
+  BasicBlock* Cur = CI->getParent();
+  BasicBlock* Next = Cur->splitBasicBlock(CI, "afterMonitorExit");
+  Cur->getTerminator()->eraseFromParent();
+  currentBlock = Cur;
+  Value* obj = CI->getArgOperand(0);
+  CI->eraseFromParent();
+  inlineMonitorExit(obj);
+  BranchInst::Create(Next, currentBlock);
+}
+
+void JavaJIT::inlineMonitorEnter(Value* obj) {
+  Value* lockPtr = objectToHeader(obj);
+
+  Value* header = new LoadInst(lockPtr, "", currentBlock);
 
   Value* threadId = getMutatorThreadPtr();
   threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
                               currentBlock);
+
+  Value* NonLockBitsMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                            vmkit::ThinLock::NonLockBitsMask);
+  Value* BiasedMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                       vmkit::ThinLock::BiasedMask);
+  Value* ThinCountMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                          vmkit::ThinLock::ThinCountMask);
+  Value* ThinCountAdd = ConstantInt::get(intrinsics->pointerSizeType,
+                                         vmkit::ThinLock::ThinCountAdd);
+
+  // Without the bias states, biased locks are left to the runtime.
+  Constant* States = TheCompiler->getLockBiasStates();
+
+  BasicBlock* OK = createBasicBlock("synchronize passed");
+  BasicBlock* NotOK = createBasicBlock("synchronize did not pass");
+  BasicBlock* Biased =
+    States ? createBasicBlock("monitorEnter_Biased") : NotOK;
+  BasicBlock* NotBiased = createBasicBlock("monitorEnter_NotBiased");
+  BasicBlock* Recursive = createBasicBlock("monitorEnter_Recursive");
+
+  Value* biased = BinaryOperator::CreateAnd(header, BiasedMask, "",
+                                            currentBlock);
+  biased = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, biased,
+                        intrinsics->constantPtrZero, "");
+  BranchInst::Create(Biased, NotBiased, biased, currentBlock);
+
+  // The lock is biased. If it is biased towards this thread, its count is not
+  // full and its type is still biased, take it with a plain store.
+  if (States) {
+    currentBlock = Biased;
+    Value* OwnerMask = ConstantInt::get(
+        intrinsics->pointerSizeType,
+        vmkit::System::GetThreadIDMask() &
+            ~(vmkit::ThinLock::FatMask | vmkit::ThinLock::BiasedMask));
+    Value* owner = BinaryOperator::CreateAnd(header, OwnerMask, "",
+                                             currentBlock);
+    Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, owner,
+                               threadId, "");
+    Value* count = BinaryOperator::CreateAnd(header, ThinCountMask, "",
+                                             currentBlock);
+    Value* notFull = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                                  ThinCountMask, "");
+    test = BinaryOperator::CreateAnd(test, notFull, "", currentBlock);
+    test = BinaryOperator::CreateAnd(test, isBiasable(obj, States), "",
+                                     currentBlock);
+    BasicBlock* BiasedOwner = createBasicBlock("monitorEnter_BiasedOwner");
+    BranchInst::Create(BiasedOwner, NotOK, test, currentBlock);
+
+    currentBlock = BiasedOwner;
+    Value* newHeader = BinaryOperator::CreateAdd(header, ThinCountAdd, "",
+                                                 currentBlock);
+    new StoreInst(newHeader, lockPtr, currentBlock);
+    BranchInst::Create(OK, currentBlock);
+  }
+
+  // The lock is not biased. Try to take it if it is free.
+  currentBlock = NotBiased;
+
+  Value* lock = BinaryOperator::CreateAnd(header, NonLockBitsMask, "",
+                                          currentBlock);
+
   Value* newValMask = BinaryOperator::CreateOr(threadId, lock, "",
                                                currentBlock);
+  if (States) {
+    // Bias the lock towards this thread, held once.
+    Value* BiasedHeld = ConstantInt::get(
+        intrinsics->pointerSizeType,
+        vmkit::ThinLock::BiasedMask | vmkit::ThinLock::ThinCountAdd);
+    Value* biasedValMask = BinaryOperator::CreateOr(newValMask, BiasedHeld,
+                                                    "", currentBlock);
+    newValMask = SelectInst::Create(isBiasable(obj, States), biasedValMask,
+                                    newValMask, "", currentBlock);
+  }
 
   // Do the atomic compare and swap.
   Value* atomic = new AtomicCmpXchgInst(
@@ -680,13 +852,40 @@ void JavaJIT::monitorEnter(Value* obj) {
   
   Value* cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, atomic,
                             lock, "");
-  
-  BasicBlock* OK = createBasicBlock("synchronize passed");
-  BasicBlock* NotOK = createBasicBlock("synchronize did not pass");
 
+  BranchInst::Create(OK, Recursive, cmp, currentBlock);
+
+  // The lock is not free. If this thread holds the thin lock and its count is
+  // not full, increment the count. Only the owner changes the lock bits, but
+  // other threads may set the hash bits.
+  currentBlock = Recursive;
+  Value* ownerBits = BinaryOperator::CreateAnd(
+      atomic,
+      ConstantInt::get(intrinsics->pointerSizeType,
+                       ~(vmkit::ThinLock::NonLockBitsMask |
+                         vmkit::ThinLock::ThinCountMask)),
+      "", currentBlock);
+  Value* test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, ownerBits,
+                             threadId, "");
+  Value* count = BinaryOperator::CreateAnd(atomic, ThinCountMask, "",
+                                           currentBlock);
+  Value* notFull = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                                ThinCountMask, "");
+  test = BinaryOperator::CreateAnd(test, notFull, "", currentBlock);
+  BasicBlock* RecursiveCAS = createBasicBlock("monitorEnter_RecursiveCAS");
+  BranchInst::Create(RecursiveCAS, NotOK, test, currentBlock);
+
+  currentBlock = RecursiveCAS;
+  Value* newHeader = BinaryOperator::CreateAdd(atomic, ThinCountAdd, "",
+                                               currentBlock);
+  Value* recursiveAtomic = new AtomicCmpXchgInst(
+      lockPtr, atomic, newHeader, SequentiallyConsistent, CrossThread,
+      currentBlock);
+  cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, recursiveAtomic,
+                     atomic, "");
   BranchInst::Create(OK, NotOK, cmp, currentBlock);
 
-  // The atomic CAS did not work.
+  // Contention or inflation: call the runtime.
   currentBlock = NotOK;
   CallInst::Create(intrinsics->AquireObjectFunction, obj, "", currentBlock);
   BranchInst::Create(OK, currentBlock);
@@ -694,7 +893,7 @@ void JavaJIT::monitorEnter(Value* obj) {
   currentBlock = OK;
 }
 
-void JavaJIT::monitorExit(Value* obj) {
+void JavaJIT::inlineMonitorExit(Value* obj) {
 	// obj should not be null if we are here.
     BasicBlock* nonNullObjBlock = createBasicBlock("monitorExit_nonNullObj");
     BasicBlock* EndBlock = createBasicBlock("monitorExit_End");
@@ -708,24 +907,76 @@ void JavaJIT::monitorExit(Value* obj) {
 
   Value* lock = new LoadInst(lockPtr, "", currentBlock);
 
+  Value* threadId = getMutatorThreadPtr();
+  threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
+                              currentBlock);
+
   Value* NonLockBitsMask = ConstantInt::get(
       intrinsics->pointerSizeType, vmkit::ThinLock::NonLockBitsMask);
+  Value* BiasedMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                       vmkit::ThinLock::BiasedMask);
+  Value* ThinCountMask = ConstantInt::get(intrinsics->pointerSizeType,
+                                          vmkit::ThinLock::ThinCountMask);
+  Value* ThinCountAdd = ConstantInt::get(intrinsics->pointerSizeType,
+                                         vmkit::ThinLock::ThinCountAdd);
+
+  Constant* States = TheCompiler->getLockBiasStates();
+
+  BasicBlock* LockFreeCASFailed = createBasicBlock("Lock-Free CAS Failed");
+  BasicBlock* Biased =
+    States ? createBasicBlock("monitorExit_Biased") : LockFreeCASFailed;
+  BasicBlock* NotBiased = createBasicBlock("monitorExit_NotBiased");
+  BasicBlock* Recursive = createBasicBlock("monitorExit_Recursive");
+
+  Value* biased = BinaryOperator::CreateAnd(lock, BiasedMask, "",
+                                            currentBlock);
+  biased = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, biased,
+                        intrinsics->constantPtrZero, "");
+  BranchInst::Create(Biased, NotBiased, biased, currentBlock);
+
+  // The lock is biased. If it is biased towards this thread and held,
+  // decrement the count with a plain store, unless this is the last release
+  // of a lock whose type is not biased anymore: the runtime removes the bias
+  // then.
+  if (States) {
+    currentBlock = Biased;
+    Value* OwnerMask = ConstantInt::get(
+        intrinsics->pointerSizeType,
+        vmkit::System::GetThreadIDMask() &
+            ~(vmkit::ThinLock::FatMask | vmkit::ThinLock::BiasedMask));
+    Value* owner = BinaryOperator::CreateAnd(lock, OwnerMask, "",
+                                             currentBlock);
+    Value* isOwner = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, owner,
+                                  threadId, "");
+    Value* count = BinaryOperator::CreateAnd(lock, ThinCountMask, "",
+                                             currentBlock);
+    Value* held = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                               intrinsics->constantPtrZero, "");
+    Value* nested = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                                 ThinCountAdd, "");
+    test = BinaryOperator::CreateOr(nested, isBiasable(obj, States), "",
+                                    currentBlock);
+    test = BinaryOperator::CreateAnd(test, held, "", currentBlock);
+    test = BinaryOperator::CreateAnd(test, isOwner, "", currentBlock);
+    BasicBlock* BiasedOwner = createBasicBlock("monitorExit_BiasedOwner");
+    BranchInst::Create(BiasedOwner, LockFreeCASFailed, test, currentBlock);
+
+    currentBlock = BiasedOwner;
+    Value* newHeader = BinaryOperator::CreateSub(lock, ThinCountAdd, "",
+                                                 currentBlock);
+    new StoreInst(newHeader, lockPtr, currentBlock);
+    BranchInst::Create(EndBlock, currentBlock);
+  }
+
+  // The lock is not biased. Free it if this thread holds it once.
+  currentBlock = NotBiased;
 
   Value* lockedMask = BinaryOperator::CreateAnd(
       lock, NonLockBitsMask, "", currentBlock);
   
-  Value* threadId = getMutatorThreadPtr();
-  threadId = new PtrToIntInst(threadId, intrinsics->pointerSizeType, "",
-                              currentBlock);
-  
   Value* oldValMask = BinaryOperator::CreateOr(threadId, lockedMask, "",
                                                currentBlock);
 
-  std::vector<Value*> atomicArgs;
-  atomicArgs.push_back(lockPtr);
-  atomicArgs.push_back(oldValMask);
-  atomicArgs.push_back(lockedMask);
-
   // Do the atomic compare and swap.
   Value* atomic = new AtomicCmpXchgInst(
       lockPtr, oldValMask, lockedMask, SequentiallyConsistent, CrossThread,
@@ -733,12 +984,39 @@ void JavaJIT::monitorExit(Value* obj) {
   
   Value* cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, atomic,
                             oldValMask, "");
-  
-  BasicBlock* LockFreeCASFailed = createBasicBlock("Lock-Free CAS Failed");
 
+  BranchInst::Create(EndBlock, Recursive, cmp, currentBlock);
+
+  // If this thread holds the thin lock more than once, decrement the count.
+  currentBlock = Recursive;
+  Value* ownerBits = BinaryOperator::CreateAnd(
+      atomic,
+      ConstantInt::get(intrinsics->pointerSizeType,
+                       ~(vmkit::ThinLock::NonLockBitsMask |
+                         vmkit::ThinLock::ThinCountMask)),
+      "", currentBlock);
+  test = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, ownerBits, threadId,
+                      "");
+  Value* count = BinaryOperator::CreateAnd(atomic, ThinCountMask, "",
+                                           currentBlock);
+  Value* nested = new ICmpInst(*currentBlock, ICmpInst::ICMP_NE, count,
+                               intrinsics->constantPtrZero, "");
+  test = BinaryOperator::CreateAnd(test, nested, "", currentBlock);
+  BasicBlock* RecursiveCAS = createBasicBlock("monitorExit_RecursiveCAS");
+  BranchInst::Create(RecursiveCAS, LockFreeCASFailed, test, currentBlock);
+
+  currentBlock = RecursiveCAS;
+  Value* newHeader = BinaryOperator::CreateSub(atomic, ThinCountAdd, "",
+                                               currentBlock);
+  Value* recursiveAtomic = new AtomicCmpXchgInst(
+      lockPtr, atomic, newHeader, SequentiallyConsistent, CrossThread,
+      currentBlock);
+  cmp = new ICmpInst(*currentBlock, ICmpInst::ICMP_EQ, recursiveAtomic,
+                     atomic, "");
   BranchInst::Create(EndBlock, LockFreeCASFailed, cmp, currentBlock);
 
-  // The atomic cas did not work.
+  // Contention, inflation or a thread that does not own the lock: call the
+  // runtime.
   currentBlock = LockFreeCASFailed;
   CallInst::Create(intrinsics->ReleaseObjectFunction, obj, "", currentBlock);
   BranchInst::Create(EndBlock, currentBlock);
@@ -830,10 +1108,15 @@ Instruction* JavaJIT::inlineCompile(BasicBlock*& curBB,
   currentBlock = curBB;
   endExceptionBlock = endExBlock;
 
+  // An exception in a synchronized method first releases the lock.
+  if (isSynchro(compilingMethod->access)) {
+    endExceptionBlock = createBasicBlock("synchronizeExceptionBlock");
+  }
+
   opcodeInfos = new Opinfo[codeLen];
   memset(opcodeInfos, 0, codeLen * sizeof(Opinfo));
   for (uint32 i = 0; i < codeLen; ++i) {
-    opcodeInfos[i].exceptionBlock = endExBlock;
+    opcodeInfos[i].exceptionBlock = endExceptionBlock;
   }
   
   BasicBlock* firstBB = llvmFunction->begin();
@@ -951,6 +1234,10 @@ Instruction* JavaJIT::inlineCompile(BasicBlock*& curBB,
     endNode = PHINode::Create(returnType, 0, "", endBlock);
   }
 
+  if (isSynchro(compilingMethod->access)) {
+    beginSynchronize();
+  }
+
   reader.cursor = start;
   compileOpcodes(reader, codeLen);
   
@@ -959,7 +1246,36 @@ Instruction* JavaJIT::inlineCompile(BasicBlock*& curBB,
               UTF8Buffer(compilingClass->name).cString(),
               UTF8Buffer(compilingMethod->name).cString());
 
-  curBB = endBlock;
+  currentBlock = endBlock;
+
+  if (isSynchro(compilingMethod->access)) {
+    endSynchronize();
+    curBB = currentBlock;
+
+    currentBlock = endExceptionBlock;
+    if (pred_begin(currentBlock) == pred_end(currentBlock)) {
+      currentBlock->eraseFromParent();
+    } else {
+      endSynchronize();
+      if (endExBlock != NULL) {
+        BranchInst::Create(endExBlock, currentBlock);
+      } else {
+        // The caller has no handler, throw the pending exception to its
+        // caller.
+        Value* javaExceptionPtr =
+          getJavaExceptionPtr(getJavaThreadPtr(getMutatorThreadPtr()));
+        Value* obj = new LoadInst(javaExceptionPtr, "pendingException",
+                                  currentBlock);
+        new StoreInst(intrinsics->JavaObjectNullConstant, javaExceptionPtr,
+                      currentBlock);
+        CallInst::Create(intrinsics->ThrowExceptionFunction, obj, "",
+                         currentBlock);
+        new UnreachableInst(*llvmContext, currentBlock);
+      }
+    }
+  } else {
+    curBB = endBlock;
+  }
 
 
   removeUnusedLocals(intLocals);
@@ -1469,6 +1785,19 @@ Value* JavaJIT::getTarget(Signdef* signature) {
   return objectStack[currentStackIndex - 1 - offset];
 }
 
+bool JavaJIT::isUnsafeMonitorEnter(JavaMethod* meth) {
+  JnjvmBootstrapLoader* loader = compilingClass->classLoader->bootstrapLoader;
+  return meth->classDef->classLoader == loader &&
+         meth->classDef->name->equals(loader->unsafeName) &&
+         meth->name->equals(loader->monitorEnter);
+}
+
+void JavaJIT::lowerUnsafeMonitorEnter(std::vector<Value*>& args) {
+  Value* obj = args[1];
+  JITVerifyNull(obj);
+  monitorEnter(obj);
+}
+
 Instruction* JavaJIT::lowerMathOps(const UTF8* name, 
                                    std::vector<Value*>& args) {
   JnjvmBootstrapLoader* loader = compilingClass->classLoader->bootstrapLoader;
@@ -1620,8 +1949,11 @@ Instruction* JavaJIT::invokeInline(JavaMethod* meth,
               customized);
 #endif
   
+  // Without handlers, exceptions are not pending here but thrown to the
+  // caller of the function.
   Instruction* ret = jit.inlineCompile(currentBlock, 
-                                       currentExceptionBlock, args);
+                                       nbHandlers ? currentExceptionBlock : NULL,
+                                       args);
   inlineMethods[meth] = false;
   return ret;
 }
@@ -69,6 +69,14 @@ struct Opinfo {
   /// backEdge - If this block is a back edge.
   bool backEdge;
 
+  /// loopPoll - If this block is the head of a counted loop, how the loop
+  /// polls for safe points. See JavaJIT::analyseLoopPolls.
+  uint8 loopPoll;
+
+  /// loopCounter - The local incremented by one on each iteration of a
+  /// strip-mined loop.
+  uint16 loopCounter;
+
 
   // isReachable - Indicate if the opcode is Reachable
   bool isReachable;
@@ -121,6 +129,14 @@ public:
   // The number of handlers in that method.
   uint32_t nbHandlers;
 
+  /// lowerMonitorEnter - Replace a call to acquire a lock, emitted by
+  /// monitorEnter, with the inline fast path of the lock.
+  void lowerMonitorEnter(llvm::CallInst* CI);
+
+  /// lowerMonitorExit - Replace a call to release a lock, emitted by
+  /// monitorExit, with the inline fast path of the lock.
+  void lowerMonitorExit(llvm::CallInst* CI);
+
 private:
   /// Whether the method overrides 'this'.
   bool overridesThis;
@@ -217,8 +233,10 @@ private:
 //===--------------------------- Inline support ---------------------------===//
 
   /// inlineCompile - Parse the method and start its LLVM representation
-  /// at curBB. endExBlock is the exception destination. args is the
-  /// arguments of the method.
+  /// at curBB. endExBlock is the exception destination, or NULL if
+  /// exceptions are thrown to the caller of the function. args is the
+  /// arguments of the method. A synchronized method holds its lock
+  /// around the inlined body, and releases it on exceptions.
   llvm::Instruction* inlineCompile(llvm::BasicBlock*& curBB,
                                    llvm::BasicBlock* endExBlock,
                                    std::vector<llvm::Value*>& args);
@@ -249,6 +267,10 @@ private:
 
   /// exploreOpcodes - Parse the bytecode and create the basic blocks.
   void exploreOpcodes(Reader& reader, uint32 codeLength);
+
+  /// analyseLoopPolls - Find the counted loops that do not need to poll for
+  /// safe points on every iteration. Called by exploreOpcodes.
+  void analyseLoopPolls(Reader& reader, uint32 codeLength);
   
   /// readExceptionTable - Read the exception table in the bytecode. Prepare
   /// exception destination for all Java instructions and set the exception
@@ -466,12 +488,26 @@ private:
   /// class.
   void endSynchronize();
 
+  /// isBiasable - Emit code to test whether the lock of the object may be
+  /// biased, reading the bias states of the lock system.
+  llvm::Value* isBiasable(llvm::Value* obj, llvm::Constant* States);
+
   /// monitorEnter - Emit synchronization code to acquire the lock of the value.
+  /// This is a call to the runtime until lowerMonitorEnter.
   void monitorEnter(llvm::Value* obj);
   
   /// monitorExit - Emit synchronization code to release the lock of the value.
+  /// This is a call to the runtime until lowerMonitorExit.
   void monitorExit(llvm::Value* obj);
 
+  /// inlineMonitorEnter - Emit the thin lock fast path to acquire the lock of
+  /// the value, calling the runtime on contention or inflation.
+  void inlineMonitorEnter(llvm::Value* obj);
+
+  /// inlineMonitorExit - Emit the thin lock fast path to release the lock of
+  /// the value, calling the runtime on contention or inflation.
+  void inlineMonitorExit(llvm::Value* obj);
+
 //===----------------------- Java field accesses  -------------------------===//
 
   /// getStaticField - Emit code to get the static field declared at the given
@@ -552,6 +588,16 @@ private:
   llvm::Instruction* lowerDoubleOps(const UTF8* name, 
                                     std::vector<llvm::Value*>& args);
  
+  /// isUnsafeMonitorEnter - Whether the method is Unsafe.monitorEnter of the
+  /// bootstrap loader.
+  bool isUnsafeMonitorEnter(JavaMethod* meth);
+
+  /// lowerUnsafeMonitorEnter - Compile Unsafe.monitorEnter like the
+  /// monitorenter bytecode. Unsafe.monitorExit stays a native call: unlike
+  /// monitorexit, it may be called by a thread that does not own the lock,
+  /// and must throw IllegalMonitorStateException then.
+  void lowerUnsafeMonitorEnter(std::vector<llvm::Value*>& args);
+
   /// lowerArraycopy - Create a fast path for System.arraycopy.
   void lowerArraycopy(std::vector<llvm::Value*>& args);
 
@@ -570,6 +616,25 @@ private:
 //===--------------------- Yield point support  ---------------------------===//
 
   void checkYieldPoint();
+
+  /// checkStripMinedYieldPoint - Poll for safe points every
+  /// StripMineLength iterations of the loop counting with the given local.
+  void checkStripMinedYieldPoint(uint16 local);
+
+  /// Ways a loop head polls for safe points.
+  enum {
+    PollEveryIteration = 0,
+    PollNever,
+    PollStripMined
+  };
+
+  /// MaxUnpolledTripCount - Counted loops with at most this many iterations
+  /// do not poll.
+  static const uint32 MaxUnpolledTripCount = 1024;
+
+  /// StripMineLength - Counted loops with more iterations poll once every
+  /// StripMineLength iterations. Must be a power of two.
+  static const uint32 StripMineLength = 1024;
 };
 
 enum Opcode {
@@ -152,6 +152,22 @@ Constant* JavaJITCompiler::getNativeFunction(JavaMethod* meth, void* ptr) {
   return ConstantExpr::getIntToPtr(CI, valPtrType);
 }
 
+Constant* JavaJITCompiler::getSafepointPollOffset() {
+  if (!JavaThread::get()->getJVM()->rendezvous.usesPollingPages()) return NULL;
+
+  return ConstantInt::get(JavaIntrinsics.pointerSizeType,
+                          vmkit::System::GetPageSize());
+}
+
+Constant* JavaJITCompiler::getLockBiasStates() {
+  if (!vmkit::ThinLock::BiasedLocking) return NULL;
+  vmkit::LockSystem& table = JavaThread::get()->getJVM()->lockSystem;
+
+  Constant* CI = ConstantInt::get(Type::getInt64Ty(getLLVMContext()),
+                                  uint64_t(table.biasStats));
+  return ConstantExpr::getIntToPtr(CI, JavaIntrinsics.ptrType);
+}
+
 JavaJITCompiler::JavaJITCompiler(
   const std::string &ModuleID, bool compiling_garbage_collector) :
   JavaLLVMCompiler(ModuleID, compiling_garbage_collector), listener(this) {
@@ -389,7 +389,11 @@ void JavaJIT::compileOpcodes(Reader& reader, uint32 codeLength) {
       }
 
       if (opinfo->backEdge) {
-        checkYieldPoint();
+        if (opinfo->loopPoll == PollStripMined) {
+          checkStripMinedYieldPoint(opinfo->loopCounter);
+        } else if (opinfo->loopPoll != PollNever) {
+          checkYieldPoint();
+        }
       }
     }
 
@@ -3002,6 +3006,270 @@ void JavaJIT::exploreOpcodes(Reader& reader, uint32 codeLength) {
       }
     }
   }
+
+  reader.cursor = start;
+  analyseLoopPolls(reader, codeLength);
+}
+
+static sint32 readS2(const uint8* code, uint32 pos) {
+  return (sint16)((code[pos] << 8) | code[pos + 1]);
+}
+
+static sint32 readS4(const uint8* code, uint32 pos) {
+  return (sint32)(((uint32)code[pos] << 24) | ((uint32)code[pos + 1] << 16) |
+                  ((uint32)code[pos + 2] << 8) | (uint32)code[pos + 3]);
+}
+
+/// opcodeLength - The length in bytes of the instruction at pos.
+static uint32 opcodeLength(const uint8* code, uint32 pos) {
+  uint8 bytecode = code[pos];
+  switch (bytecode) {
+    case BIPUSH :
+    case LDC :
+    case NEWARRAY :
+    case RET : return 2;
+
+    case SIPUSH :
+    case LDC_W :
+    case LDC2_W :
+    case IINC :
+    case NEW :
+    case ANEWARRAY :
+    case CHECKCAST :
+    case INSTANCEOF :
+    case IFNULL :
+    case IFNONNULL : return 3;
+
+    case MULTIANEWARRAY : return 4;
+
+    case INVOKEINTERFACE :
+    case UNUSED :
+    case GOTO_W :
+    case JSR_W : return 5;
+
+    case WIDE : return code[pos + 1] == IINC ? 6 : 4;
+
+    case TABLESWITCH : {
+      uint32 base = (pos + 4) & ~3;
+      sint32 low = readS4(code, base + 4);
+      sint32 high = readS4(code, base + 8);
+      return base + 12 + ((high - low + 1) << 2) - pos;
+    }
+
+    case LOOKUPSWITCH : {
+      uint32 base = (pos + 4) & ~3;
+      sint32 nbs = readS4(code, base + 4);
+      return base + 8 + (nbs << 3) - pos;
+    }
+  }
+
+  if (bytecode >= ILOAD && bytecode <= ALOAD) return 2;
+  if (bytecode >= ISTORE && bytecode <= ASTORE) return 2;
+  if (bytecode >= IFEQ && bytecode <= JSR) return 3;
+  if (bytecode >= GETSTATIC && bytecode <= INVOKESTATIC) return 3;
+  return 1;
+}
+
+/// branchTargets - Add the targets of the instruction at pos to targets.
+static void branchTargets(const uint8* code, uint32 pos,
+                          std::vector<uint32>& targets) {
+  uint8 bytecode = code[pos];
+  if ((bytecode >= IFEQ && bytecode <= JSR) ||
+      bytecode == IFNULL || bytecode == IFNONNULL) {
+    targets.push_back(pos + readS2(code, pos + 1));
+  } else if (bytecode == GOTO_W || bytecode == JSR_W) {
+    targets.push_back(pos + readS4(code, pos + 1));
+  } else if (bytecode == TABLESWITCH) {
+    uint32 base = (pos + 4) & ~3;
+    sint32 low = readS4(code, base + 4);
+    sint32 high = readS4(code, base + 8);
+    targets.push_back(pos + readS4(code, base));
+    for (sint32 cur = 0; cur <= high - low; ++cur) {
+      targets.push_back(pos + readS4(code, base + 12 + (cur << 2)));
+    }
+  } else if (bytecode == LOOKUPSWITCH) {
+    uint32 base = (pos + 4) & ~3;
+    sint32 nbs = readS4(code, base + 4);
+    targets.push_back(pos + readS4(code, base));
+    for (sint32 cur = 0; cur < nbs; ++cur) {
+      targets.push_back(pos + readS4(code, base + 12 + (cur << 3)));
+    }
+  }
+}
+
+/// intConstant - If the instruction at pos pushes an int constant, set value
+/// to the constant and return true.
+static bool intConstant(const uint8* code, uint32 pos, sint32& value) {
+  uint8 bytecode = code[pos];
+  if (bytecode >= ICONST_M1 && bytecode <= ICONST_5) {
+    value = (sint32)bytecode - ICONST_0;
+  } else if (bytecode == BIPUSH) {
+    value = (sint8)code[pos + 1];
+  } else if (bytecode == SIPUSH) {
+    value = readS2(code, pos + 1);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/// intLocal - If the instruction at pos is an int load (or store when store
+/// is true) of a local, return the local. Return -1 otherwise.
+static sint32 intLocal(const uint8* code, uint32 pos, bool store) {
+  uint8 bytecode = code[pos];
+  uint8 op = store ? ISTORE : ILOAD;
+  uint8 op0 = store ? ISTORE_0 : ILOAD_0;
+  if (bytecode == op) return code[pos + 1];
+  if (bytecode >= op0 && bytecode <= op0 + 3) return bytecode - op0;
+  if (bytecode == WIDE && code[pos + 1] == op) return readS2(code, pos + 2);
+  return -1;
+}
+
+/// writesIntLocal - If the instruction at pos may change the given local.
+static bool writesIntLocal(const uint8* code, uint32 pos, sint32 local) {
+  uint8 bytecode = code[pos];
+  if (bytecode == IINC) return code[pos + 1] == local;
+  if (bytecode == WIDE && code[pos + 1] == IINC) {
+    return (uint16)readS2(code, pos + 2) == local;
+  }
+  return intLocal(code, pos, true) == local;
+}
+
+// Counted loops, as javac compiles them:
+//
+//           <push init>
+//           istore k
+//           goto cond
+//   head:   <body>            no other write to k, no inner loop
+//           iinc k step
+//   cond:   iload k
+//           <push bound>      constant, local or array length
+//           if_icmplt head    or if_icmple
+//
+// The head is only reached from the back edge and the condition only from
+// the iinc and the goto, so every iteration adds step to k. With a constant
+// init and bound the trip count is known, and small loops do not poll. Loops
+// with a step of one poll when k is a multiple of StripMineLength.
+void JavaJIT::analyseLoopPolls(Reader& reader, uint32 codeLength) {
+  if (!TheCompiler->useCooperativeGC()) return;
+
+  bool hasBackEdge = false;
+  for (uint32 i = 0; i < codeLength; ++i) {
+    if (opcodeInfos[i].backEdge) {
+      hasBackEdge = true;
+      break;
+    }
+  }
+  if (!hasBackEdge) return;
+
+  const uint8* code = &(reader.bytes->elements[reader.cursor]);
+  std::vector<uint32> starts;
+  std::vector<uint16> nbBranches(codeLength + 1, 0);
+  std::vector<uint32> targets;
+  for (uint32 i = 0; i < codeLength; i += opcodeLength(code, i)) {
+    starts.push_back(i);
+    targets.clear();
+    branchTargets(code, i, targets);
+    for (uint32 j = 0; j < targets.size(); ++j) {
+      if (targets[j] < codeLength) nbBranches[targets[j]]++;
+    }
+  }
+
+  for (uint32 b = 4; b < starts.size(); ++b) {
+    uint32 pos = starts[b];
+    uint8 bytecode = code[pos];
+    if (bytecode != IF_ICMPLT && bytecode != IF_ICMPLE) continue;
+    uint32 head = pos + readS2(code, pos + 1);
+    if (head >= pos || !opcodeInfos[head].backEdge) continue;
+    Opinfo& info = opcodeInfos[head];
+    if (info.handler || nbBranches[head] != 1) continue;
+
+    // Find the head and the instructions before it.
+    uint32 h = 0;
+    while (h < b && starts[h] < head) ++h;
+    if (starts[h] != head || h < 3) continue;
+
+    // The bound: a constant, a local or an array length, without branches.
+    sint32 bound = 0;
+    bool constantBound = false;
+    uint32 c = b - 1;
+    if (intConstant(code, starts[c], bound)) {
+      constantBound = true;
+    } else if (code[starts[c]] == ARRAYLENGTH &&
+               code[starts[c - 1]] >= ALOAD_0 &&
+               code[starts[c - 1]] <= ALOAD_3) {
+      --c;
+    } else if (code[starts[c]] == ARRAYLENGTH &&
+               code[starts[c - 1]] == ALOAD) {
+      --c;
+    } else if (intLocal(code, starts[c], false) < 0) {
+      continue;
+    }
+    if (c < h + 2) continue;
+    bool entered = false;
+    for (uint32 j = c; j <= b; ++j) {
+      if (nbBranches[starts[j]] != 0) entered = true;
+    }
+    if (entered) continue;
+
+    // The condition loads the counter right after the increment, and is only
+    // entered from the goto before the head.
+    uint32 cond = c - 1;
+    sint32 local = intLocal(code, starts[cond], false);
+    uint32 inc = cond - 1;
+    if (local < 0 || code[starts[inc]] != IINC ||
+        code[starts[inc] + 1] != local) continue;
+    sint32 step = (sint8)code[starts[inc] + 2];
+    if (step <= 0) continue;
+    if (nbBranches[starts[cond]] != 1 || code[starts[h - 1]] != GOTO ||
+        starts[h - 1] + readS2(code, starts[h - 1] + 1) != starts[cond]) {
+      continue;
+    }
+
+    // The body does not contain inner loops or other writes to the counter,
+    // and no branch from outside the loop enters it.
+    bool simple = true;
+    for (uint32 j = 0; j < starts.size() && simple; ++j) {
+      uint32 cur = starts[j];
+      targets.clear();
+      branchTargets(code, cur, targets);
+      bool inside = cur >= head && cur <= pos;
+      for (uint32 t = 0; t < targets.size(); ++t) {
+        uint32 target = targets[t];
+        bool toBody = target > head && target <= pos;
+        if (inside && target <= cur && cur != pos) simple = false;
+        if (!inside && toBody && cur != starts[h - 1]) simple = false;
+      }
+      if (inside && cur < starts[inc] && writesIntLocal(code, cur, local)) {
+        simple = false;
+      }
+      if (inside && (code[cur] == JSR || code[cur] == JSR_W ||
+                     code[cur] == RET)) {
+        simple = false;
+      }
+      if (cur > head && cur <= pos && opcodeInfos[cur].handler) {
+        simple = false;
+      }
+    }
+    if (!simple) continue;
+
+    sint32 init = 0;
+    if (constantBound && intLocal(code, starts[h - 2], true) == local &&
+        intConstant(code, starts[h - 3], init)) {
+      sint64 trips = 0;
+      sint64 last = bytecode == IF_ICMPLE ? (sint64)bound + 1 : bound;
+      if (last > init) trips = (last - init + step - 1) / step;
+      if (trips <= MaxUnpolledTripCount) {
+        info.loopPoll = PollNever;
+        continue;
+      }
+    }
+
+    if (step == 1) {
+      info.loopPoll = PollStripMined;
+      info.loopCounter = local;
+    }
+  }
 }
 
 bool JavaJIT::canInlineLoadConstant(uint16 index) {
@@ -105,12 +105,18 @@ JavaLLVMCompiler::~JavaLLVMCompiler() {
 }
 
 llvm::FunctionPass* createLowerConstantCallsPass(JavaLLVMCompiler* I);
+llvm::FunctionPass* createLockCoarseningPass(JavaLLVMCompiler* I);
+llvm::FunctionPass* createInlineMonitorsPass(JavaLLVMCompiler* I);
 
 void JavaLLVMCompiler::addJavaPasses() {
   JavaNativeFunctionPasses = new FunctionPassManager(TheModule);
   JavaNativeFunctionPasses->add(new DataLayout(TheModule));
 
   J3FunctionPasses = new FunctionPassManager(TheModule);
+  // Monitor operations stay calls through the optimizations, so that they
+  // can be merged, and are lowered before the calls they use.
+  J3FunctionPasses->add(createLockCoarseningPass(this));
+  J3FunctionPasses->add(createInlineMonitorsPass(this));
   J3FunctionPasses->add(createLowerConstantCallsPass(this));
   
   JavaFunctionPasses = new FunctionPassManager(TheModule);
@@ -0,0 +1,217 @@
+//===------- LockCoarsening.cpp - Merge nearby monitor regions ------------===//
+//
+//                            The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Debug.h"
+
+#include <vector>
+
+#include "j3/JavaLLVMCompiler.h"
+#include "j3/J3Intrinsics.h"
+
+using namespace llvm;
+
+namespace j3 {
+
+/// LockCoarsening - Merge a monitor region with the next one on the same
+/// object, when only straight-line code without calls sits between them.
+/// The release of the first region and the acquire of the second one are
+/// removed. Runs before InlineMonitors, while monitor operations are calls.
+///
+class LockCoarsening : public FunctionPass {
+public:
+  static char ID;
+  JavaLLVMCompiler* TheCompiler;
+  LockCoarsening(JavaLLVMCompiler* Compiler) : FunctionPass(ID),
+    TheCompiler(Compiler) { }
+
+  const char* getPassName() const { return "Coarsen Java locks"; }
+
+  virtual bool runOnFunction(Function &F);
+
+  /// CoarseningBudget - The maximum number of instructions of a merged
+  /// region, which holds its lock for longer than the original ones.
+  static const unsigned CoarseningBudget = 64;
+
+private:
+  Function* Acquire;
+  Function* Release;
+
+  bool isCall(Instruction* I, Function* F) {
+    CallInst* CI = dyn_cast<CallInst>(I);
+    return CI != NULL && CI->getCalledValue() == F;
+  }
+
+  /// findAcquire - The acquire of the same object after the release, if the
+  /// code between them may run with the lock held. Sets gap to the number of
+  /// instructions between them.
+  CallInst* findAcquire(CallInst* release, unsigned& gap);
+
+  /// regionSize - The number of instructions of the region that ends with
+  /// the release, or that starts with the acquire, if it is straight-line
+  /// code. Returns CoarseningBudget + 1 otherwise.
+  unsigned regionSize(CallInst* CI, bool backward);
+};
+char LockCoarsening::ID = 0;
+
+/// nextInTrace - The instruction that always executes after I, or NULL if
+/// control flow merges or branches.
+static Instruction* nextInTrace(Instruction* I) {
+  if (!isa<TerminatorInst>(I)) {
+    BasicBlock::iterator It = I;
+    return ++It;
+  }
+  BranchInst* BI = dyn_cast<BranchInst>(I);
+  if (BI == NULL || BI->isConditional()) return NULL;
+  BasicBlock* Succ = BI->getSuccessor(0);
+  if (Succ->getSinglePredecessor() == NULL) return NULL;
+  return Succ->begin();
+}
+
+/// previousInTrace - The instruction that always executes before I, or NULL
+/// if control flow merges or branches.
+static Instruction* previousInTrace(Instruction* I) {
+  BasicBlock* BB = I->getParent();
+  if (I != BB->begin()) {
+    BasicBlock::iterator It = I;
+    return --It;
+  }
+  BasicBlock* Pred = BB->getSinglePredecessor();
+  if (Pred == NULL) return NULL;
+  BranchInst* BI = dyn_cast<BranchInst>(Pred->getTerminator());
+  if (BI == NULL || BI->isConditional()) return NULL;
+  return BI;
+}
+
+/// getLockedObject - Look through casts and the stack slots of the JIT to
+/// find where the object comes from.
+static Value* getLockedObject(Value* V) {
+  for (unsigned depth = 0; depth < 16; ++depth) {
+    V = V->stripPointerCasts();
+    LoadInst* LI = dyn_cast<LoadInst>(V);
+    if (LI == NULL) return V;
+    AllocaInst* AI = dyn_cast<AllocaInst>(LI->getPointerOperand());
+    if (AI == NULL) return V;
+
+    // The last store to the slot in the block of the load, or else the only
+    // store to the slot.
+    StoreInst* Store = NULL;
+    BasicBlock::iterator It = LI;
+    for (BasicBlock::iterator B = LI->getParent()->begin(); It != B;) {
+      StoreInst* SI = dyn_cast<StoreInst>(--It);
+      if (SI != NULL && SI->getPointerOperand() == AI) {
+        Store = SI;
+        break;
+      }
+    }
+    if (Store == NULL) {
+      for (Value::use_iterator U = AI->use_begin(), E = AI->use_end();
+           U != E; ++U) {
+        StoreInst* SI = dyn_cast<StoreInst>(*U);
+        if (SI == NULL || SI->getPointerOperand() != AI) continue;
+        if (Store != NULL) return V;
+        Store = SI;
+      }
+      if (Store == NULL) return V;
+    }
+    V = Store->getValueOperand();
+  }
+  return V;
+}
+
+/// canHoldLock - Whether the instruction may execute with a lock held for
+/// longer. Calls may block or reach a safe point, and volatile accesses may
+/// be safe point polls or implicit null checks, whose exception would not
+/// release the lock.
+static bool canHoldLock(Instruction* I) {
+  if (isa<IntrinsicInst>(I)) return true;
+  if (isa<CallInst>(I) || isa<InvokeInst>(I)) return false;
+  if (LoadInst* LI = dyn_cast<LoadInst>(I)) return !LI->isVolatile();
+  if (StoreInst* SI = dyn_cast<StoreInst>(I)) return !SI->isVolatile();
+  if (isa<AtomicCmpXchgInst>(I) || isa<AtomicRMWInst>(I)) return false;
+  if (isa<FenceInst>(I)) return false;
+  return true;
+}
+
+CallInst* LockCoarsening::findAcquire(CallInst* release, unsigned& gap) {
+  Value* obj = getLockedObject(release->getArgOperand(0));
+  gap = 0;
+  for (Instruction* I = nextInTrace(release); I != NULL;
+       I = nextInTrace(I)) {
+    if (isCall(I, Acquire)) {
+      CallInst* CI = cast<CallInst>(I);
+      if (getLockedObject(CI->getArgOperand(0)) == obj) return CI;
+      return NULL;
+    }
+    if (!canHoldLock(I)) return NULL;
+    if (++gap > CoarseningBudget) return NULL;
+  }
+  return NULL;
+}
+
+unsigned LockCoarsening::regionSize(CallInst* CI, bool backward) {
+  Value* obj = getLockedObject(CI->getArgOperand(0));
+  Function* End = backward ? Acquire : Release;
+  unsigned size = 0;
+  for (Instruction* I = backward ? previousInTrace(CI) : nextInTrace(CI);
+       I != NULL;
+       I = backward ? previousInTrace(I) : nextInTrace(I)) {
+    if (isCall(I, End) &&
+        getLockedObject(cast<CallInst>(I)->getArgOperand(0)) == obj) {
+      return size;
+    }
+    if (++size > CoarseningBudget) break;
+  }
+  return CoarseningBudget + 1;
+}
+
+bool LockCoarsening::runOnFunction(Function& F) {
+  J3Intrinsics* intrinsics = TheCompiler->getIntrinsics();
+  Acquire = intrinsics->AquireObjectFunction;
+  Release = intrinsics->ReleaseObjectFunction;
+
+  std::vector<CallInst*> releases;
+  for (Function::iterator BI = F.begin(), BE = F.end(); BI != BE; BI++) {
+    for (BasicBlock::iterator II = BI->begin(), IE = BI->end(); II != IE;
+         II++) {
+      if (isCall(II, Release)) releases.push_back(cast<CallInst>(II));
+    }
+  }
+
+  bool Changed = false;
+  for (std::vector<CallInst*>::iterator I = releases.begin(),
+       E = releases.end(); I != E; ++I) {
+    CallInst* release = *I;
+    unsigned gap = 0;
+    CallInst* acquire = findAcquire(release, gap);
+    if (acquire == NULL) continue;
+
+    // A previous merge may have grown the region that ends here.
+    unsigned size = regionSize(release, true) + gap;
+    if (size > CoarseningBudget) continue;
+    size += regionSize(acquire, false);
+    if (size > CoarseningBudget) continue;
+
+    release->eraseFromParent();
+    acquire->eraseFromParent();
+    Changed = true;
+  }
+  return Changed;
+}
+
+
+FunctionPass* createLockCoarseningPass(JavaLLVMCompiler* Compiler) {
+  return new LockCoarsening(Compiler);
+}
+
+}
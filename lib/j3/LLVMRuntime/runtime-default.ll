@@ -41,7 +41,11 @@
 ;;; field 9:  void*  routine
 ;;; field 10: void*  lastKnownFrame
 ;;; field 11: void*  lastExceptionBuffer
-%Thread = type { %CircularBase, i32, i8*, i8*, i1, i1, i1, i8*, i8*, i8*, i8*, i8* }
+;;; field 12: uint32 safepointHistogram[6]
+;;; field 13: void*  handshakeOp
+;;; field 14: int32  handshakeState
+%Thread = type { %CircularBase, i32, i8*, i8*, i1, i1, i1, i8*, i8*, i8*, i8*, i8*,
+                 [6 x i32], i8*, i32 }
 
 %JavaThread = type { %MutatorThread, i8*, %JavaObject* }
 
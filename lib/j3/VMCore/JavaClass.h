@@ -1022,6 +1022,38 @@ public:
 private:
 	jvalue* marshalArguments(vmkit::ThreadAllocator& allocator, va_list ap);
 
+	/// VirtualBufCall, StaticBufCall - A call to Java from an attached thread
+	/// running on its own stack. The call is made on the stack of the
+	/// thread's slot, see vmkit::Thread::callOnStack.
+	template<class TYPE, class FUNC_TYPE_VIRTUAL_BUF>
+	struct VirtualBufCall {
+		FUNC_TYPE_VIRTUAL_BUF call;
+		UserConstantPool* ctp;
+		void* func;
+		JavaObject* obj;
+		void* buf;
+		TYPE res;
+
+		static void run(void* arg) {
+			VirtualBufCall* c = (VirtualBufCall*)arg;
+			c->res = c->call(c->ctp, c->func, c->obj, c->buf);
+		}
+	};
+
+	template<class TYPE, class FUNC_TYPE_STATIC_BUF>
+	struct StaticBufCall {
+		FUNC_TYPE_STATIC_BUF call;
+		UserConstantPool* ctp;
+		void* func;
+		void* buf;
+		TYPE res;
+
+		static void run(void* arg) {
+			StaticBufCall* c = (StaticBufCall*)arg;
+			c->res = c->call(c->ctp, c->func, c->buf);
+		}
+	};
+
 	template<class TYPE, class FUNC_TYPE_VIRTUAL_BUF>
 	TYPE invokeSpecialBuf(Jnjvm* vm, UserClass* cl, JavaObject* obj, void* buf) __attribute__((noinline)) {
 		llvm_gcroot(obj, 0);
@@ -1035,7 +1067,14 @@ private:
 		TYPE res;
 
 		DO_TRY
-			res = call(cl->getConstantPool(), func, obj, buf);
+			if (vmkit::Thread::runsOffStack()) {
+				VirtualBufCall<TYPE, FUNC_TYPE_VIRTUAL_BUF> c =
+					{ call, cl->getConstantPool(), func, obj, buf, TYPE() };
+				th->callOnStack(c.run, &c);
+				res = c.res;
+			} else {
+				res = call(cl->getConstantPool(), func, obj, buf);
+			}
 		DO_CATCH
 
 		th->endJava();
@@ -1075,7 +1114,14 @@ private:
 		TYPE res;
 
 		DO_TRY
-			res = call(cl->getConstantPool(), func, buf);
+			if (vmkit::Thread::runsOffStack()) {
+				StaticBufCall<TYPE, FUNC_TYPE_STATIC_BUF> c =
+					{ call, cl->getConstantPool(), func, buf, TYPE() };
+				th->callOnStack(c.run, &c);
+				res = c.res;
+			} else {
+				res = call(cl->getConstantPool(), func, buf);
+			}
 		DO_CATCH
 
 		th->endJava();
@@ -62,6 +62,12 @@ uint32_t JavaObject::hashCode(JavaObject* self) {
   do {
     header = self->header();
     if ((header & HashMask) != 0) break;
+    if (header & vmkit::ThinLock::BiasedMask) {
+      // The owner of a bias writes the header without atomic operations.
+      vmkit::ThinLock::revokeBias(
+          self, JavaThread::get()->getJVM()->lockSystem, false);
+      continue;
+    }
     word_t newHeader = header | val;
     assert((newHeader & ~HashMask) == header);
     __sync_val_compare_and_swap(&(self->header()), header, newHeader);
@@ -246,6 +252,12 @@ void JavaObject::acquire(JavaObject* self) {
   JavaThread::get()->state = vmkit::LockingThread::StateRunning;
 }
 
+bool JavaObject::tryAcquire(JavaObject* self) {
+  llvm_gcroot(self, 0);
+  return vmkit::ThinLock::tryAcquire(self,
+                                     JavaThread::get()->getJVM()->lockSystem);
+}
+
 void JavaObject::release(JavaObject* self) {
   llvm_gcroot(self, 0);
   vmkit::ThinLock::release(self, JavaThread::get()->getJVM()->lockSystem);
@@ -306,6 +306,10 @@ public:
   /// acquire - Acquire the lock on this object.
   static void acquire(JavaObject* self);
 
+  /// tryAcquire - Acquire the lock on this object if it is free. Returns
+  /// whether the lock was acquired.
+  static bool tryAcquire(JavaObject* self);
+
   /// release - Release the lock on this object
   static void release(JavaObject* self);
 
@@ -8,8 +8,10 @@
 //===----------------------------------------------------------------------===//
 
 #include <sstream>
+#include <sys/time.h>
 
 #include "vmkit/Locks.h"
+#include "vmkit/System.h"
 #include "vmkit/Thread.h"
 
 #include "JavaClass.h"
@@ -41,6 +43,19 @@ void JavaThread::initialise(JavaObject* thread, JavaObject* vmth) {
   vmkit::Collector::objectReferenceNonHeapWriteBarrier((gc**)&vmThread, (gc*)vmth);
 }
 
+bool JavaThread::attach() {
+  attachedReferences = 0;
+  currentAddedReferences = &attachedReferences;
+  return vmkit::MutatorThread::attach();
+}
+
+void JavaThread::detach() {
+  localJNIRefs->removeJNIReferences(this, attachedReferences);
+  currentAddedReferences = NULL;
+  getJVM()->lockSystem.flushCache(&lockingThread);
+  vmkit::MutatorThread::detach();
+}
+
 JavaThread::~JavaThread() {
   delete localJNIRefs;
 }
@@ -198,99 +213,69 @@ ParkLock::~ParkLock() {
 
 }
 
-inline void _OrderAccess_fence() {
-    // Always use locked addl since mfence is sometimes expensive
-	__sync_synchronize();
-    //__asm__ volatile ("lock; addl $0,0(%%esp)" : : : "cc", "memory");
-}
-
 // Implementation of method park, see LockSupport.java
 // time is in nanoseconds if !isAboslute, otherwise it is in milliseconds
 void ParkLock::park(bool isAbsolute, int64_t time, JavaThread* thread) {
-	 // Optional fast-path check:
-	  // Return immediately if a permit is available.
-	  if (permit) {
-		  permit = false ;
-		  //_OrderAccess_fence();//__sync_synchronize();//OrderAccess::fence();
-	      return ;
-	  }
-
-	  // Optional optimization -- avoid state transitions if there's an interrupt pending.
-	  // Check interrupt before trying to wait
-	  if (thread->lockingThread.interruptFlag) {
-	    return;
-	  }
-
-	  if (time < 0 || (isAbsolute && time == 0) ) { // don't wait at all
-	    return;
-	  }
-
-	  // Enter safepoint region
-	  // Beware of deadlocks such as 6317397.
-	  // The per-thread Parker:: mutex is a classic leaf-lock.
-	  // In particular a thread must never block on the Threads_lock while
-	  // holding the Parker:: mutex.  If safepoints are pending both the
-	  // the ThreadBlockInVM() CTOR and DTOR may grab Threads_lock.
-	  //ThreadBlockInVM tbivm(jt);
-
-	  // Don't wait if cannot get lock since interference arises from
-	  // unblocking.  Also. check interrupt before trying wait
-	  if (thread->lockingThread.interruptFlag || lock.tryLock() != 0) {
-	    return;
-	  }
-
-
-	  int status ;
-	  if (permit)  { // no wait needed
-		permit = false;
-		lock.unlock(thread);
-		//_OrderAccess_fence();
+	// Fast path: take the permit if it is available.
+	if (__sync_lock_test_and_set(&permit, 0) == 1) {
+		return;
+	}
+
+	// Check interrupt before trying to wait
+	if (thread->lockingThread.interruptFlag) {
+		return;
+	}
+
+	if (time < 0 || (isAbsolute && time == 0) ) { // don't wait at all
 		return;
-	  }
-
-	  //OSThreadWaitState osts(thread->osthread(), false /* not Object.wait() */);
-	  //jt->set_suspend_equivalent();
-	  // cleared by handle_special_suspend_equivalent_condition() or java_suspend_self()
-
-	  if (time == 0) {
-		  //thread->setState(vmkit::LockingThread::StateWaiting);
-		  thread->setState(vmkit::LockingThread::StateWaiting);
-		  //_OrderAccess_fence();
-		  //thread->doYield = true;
-		  cond.wait(&lock);
-		  //thread->doYield = false;
-		  //cond.myTimeWait(&lock, false, 1000000000);
-	  } else {
-		  thread->setState(vmkit::LockingThread::StateTimeWaiting);
-		  cond.myTimeWait(&lock, isAbsolute, time);
-	  }
-	  thread->setState(vmkit::LockingThread::StateRunning);
-	  //thread->setState(vmkit::LockingThread::StateRunning);
-	  permit = false ;
-	  //_OrderAccess_fence();
-	  lock.unlock(thread);
-	  // If externally suspended while waiting, re-suspend
-	  //if (jt->handle_special_suspend_equivalent_condition()) {
-	  //  jt->java_suspend_self();
-	  //}
+	}
+
+	struct timespec timeout;
+	if (time != 0) {
+		int64_t nanos = time;
+		if (isAbsolute) {
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			nanos = (time - (int64_t)now.tv_sec * 1000) * 1000000 -
+			        (int64_t)now.tv_usec * 1000;
+			if (nanos <= 0) return;
+		}
+		timeout.tv_sec = nanos / 1000000000;
+		timeout.tv_nsec = nanos % 1000000000;
+	}
+
+	// Say that we sleep. If unpark gave a permit in the meantime, take it.
+	if (!__sync_bool_compare_and_swap(&permit, 0, -1)) {
+		permit = 0;
+		return;
+	}
+
+	// interrupt sets the flag before it looks at the permit, and we set the
+	// permit before we look at the flag: one of us sees the other.
+	if (!thread->lockingThread.interruptFlag) {
+		thread->setState(time == 0 ? vmkit::LockingThread::StateWaiting :
+		                             vmkit::LockingThread::StateTimeWaiting);
+		thread->enterUncooperativeCode();
+		vmkit::System::FutexWait(&permit, -1, time == 0 ? NULL : &timeout);
+		thread->leaveUncooperativeCode();
+		thread->setState(vmkit::LockingThread::StateRunning);
+	}
+
+	// Take the permit that woke us up, if any. park may return spuriously.
+	__sync_lock_test_and_set(&permit, 0);
 }
 
 void ParkLock::unpark() {
-	JavaThread* thread = (JavaThread*)vmkit::Thread::get();
-	lock.lock();
-	permit = true;
-	//_OrderAccess_fence();
-	cond.signal();
-	lock.unlock(thread);
+	if (__sync_lock_test_and_set(&permit, 1) == -1) {
+		vmkit::System::FutexWake(&permit, 1);
+	}
 }
 
 void ParkLock::interrupt() {
-	//
-	if (lock.tryLock() == 0) {
-		JavaThread* thread = (JavaThread*)vmkit::Thread::get();
-		cond.signal();
-
-		lock.unlock(thread);
+	// The interrupt flag is set. Wake up the thread without giving it a
+	// permit.
+	__sync_synchronize();
+	if (__sync_bool_compare_and_swap(&permit, -1, 0)) {
+		vmkit::System::FutexWake(&permit, 1);
 	}
-	//_OrderAccess_fence();
 }
@@ -75,11 +75,13 @@ class Jnjvm;
 
 /// This is used to implement park/unpark behavior.
 /// The functionalities is the foundation for java.util.concurrency package
+///
+/// The permit is a single futex word: 1 if a permit is available, -1 while
+/// the thread sleeps in park, 0 otherwise. Taking an available permit and
+/// unparking a thread that does not sleep never enter the kernel.
 class ParkLock {
 private:
-	vmkit::LockNormal lock;
-	vmkit::Cond cond;
-	bool permit;
+	volatile int32_t permit;
 
 public:
 	ParkLock();
@@ -144,6 +146,10 @@ public:
   // Lock to implement park/unpark
   ParkLock parkLock;
 
+  /// attachedReferences - Number of local references an attached thread
+  /// added outside of native methods. They live until the thread detaches.
+  ///
+  uint32_t attachedReferences;
 
   JavaObject** pushJNIRef(JavaObject* obj) {
     llvm_gcroot(obj, 0);
@@ -158,6 +164,10 @@ public:
   ///
   virtual void tracer(word_t closure);
 
+  /// getLockingThread - The object locking state of this thread.
+  ///
+  virtual vmkit::LockingThread* getLockingThread() { return &lockingThread; }
+
   /// JavaThread - Empty constructor, used to get the VT.
   ///
   JavaThread() {
@@ -173,6 +183,16 @@ public:
   JavaThread(vmkit::VirtualMachine* isolate);
 
   void initialise(JavaObject* thread, JavaObject* vmth);
+
+  /// attach - Attach the current native thread as this thread. The caller
+  /// creates the Java thread object.
+  ///
+  virtual bool attach();
+
+  /// detach - Release the local references of the attached thread and
+  /// detach.
+  ///
+  virtual void detach();
   
   /// get - Get the current thread as a J3 object.
   ///
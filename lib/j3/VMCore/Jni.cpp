@@ -4320,17 +4320,104 @@ jint DestroyJavaVM(JavaVM *vm) {
 }
 
 
+/// myVM - Get the VM of a JavaVM, which points to the javavmEnv field.
+static Jnjvm* myVM(JavaVM* vm) {
+  return ((Jnjvm::JavaVMEnv*)vm)->vm;
+}
+
+/// createAttachedThread - Create the Java thread object of a native thread
+/// that just attached.
+static jint createAttachedThread(Jnjvm* myvm, JavaVMAttachArgs* args,
+                                 bool isDaemon) {
+  JavaObject* group = 0;
+  llvm_gcroot(group, 0);
+
+  BEGIN_JNI_EXCEPTION
+
+  const char* name = "Attached Thread";
+  if (args != NULL && args->name != NULL && args->name[0]) name = args->name;
+  if (args != NULL && args->group != NULL) group = *(JavaObject**)args->group;
+  myvm->upcalls->AttachJavaThread(myvm, th, name, group, isDaemon);
+  RETURN_FROM_JNI(JNI_OK);
+
+  END_JNI_EXCEPTION
+
+  th->clearException();
+  RETURN_FROM_JNI(JNI_ERR);
+}
+
+/// attachCurrentThread - Attach the current native thread, which keeps its
+/// stack: the runtime finds the thread with a thread-local lookup, and calls
+/// to Java run on the stack of the thread's slot.
+static jint attachCurrentThread(JavaVM* vm, void** env, void* thr_args,
+                                bool isDaemon) {
+  vmkit::Thread* self = vmkit::Thread::get();
+  if (self->isVmkitThread()) {
+    // Threads created by the VM, and threads already attached.
+    (*env) = &(((JavaThread*)self)->getJVM()->jniEnv);
+    return JNI_OK;
+  }
+
+  JavaVMAttachArgs* args = (JavaVMAttachArgs*)thr_args;
+  if (args != NULL && args->version != JNI_VERSION_1_2 &&
+      args->version != JNI_VERSION_1_4 && args->version != JNI_VERSION_1_6) {
+    return JNI_EVERSION;
+  }
+
+  Jnjvm* myvm = myVM(vm);
+  JavaThread* th = new (vmkit::Thread::AttachedSlot) JavaThread(myvm);
+  if (!th->attach()) {
+    vmkit::Thread::releaseThread(th);
+    return JNI_ERR;
+  }
+
+  if (createAttachedThread(myvm, args, isDaemon) != JNI_OK) {
+    th->detach();
+    return JNI_ERR;
+  }
+
+  // Non-daemon threads keep the VM alive until they detach.
+  if (!isDaemon) myvm->threadSystem.enter();
+  (*env) = &(myvm->jniEnv);
+  return JNI_OK;
+}
+
 jint AttachCurrentThread(JavaVM *vm, void **env, void *thr_args) {
-  NYI();
-  abort();
-  return 0;
+  return attachCurrentThread(vm, env, thr_args, false);
 }
 
 
+/// finishAttachedThread - Run the end of the Java thread of a native thread
+/// that detaches. Returns if the thread is a daemon.
+static bool finishAttachedThread(Jnjvm* myvm) {
+  bool isDaemon = false;
+
+  BEGIN_JNI_EXCEPTION
+
+  isDaemon = myvm->upcalls->daemon->getInstanceInt8Field(th->javaThread);
+  myvm->upcalls->DetachJavaThread(myvm, th);
+  RETURN_FROM_JNI(isDaemon);
+
+  END_JNI_EXCEPTION
+
+  th->clearException();
+  RETURN_FROM_JNI(isDaemon);
+}
+
 jint DetachCurrentThread(JavaVM *vm) {
-  NYI();
-  abort();
-  return 0;
+  vmkit::Thread* self = vmkit::Thread::get();
+  if (!self->isVmkitThread()) return JNI_EDETACHED;
+  // Only attached threads detach, and not from a native method.
+  if (vmkit::Thread::getAttached() != self || !vmkit::Thread::runsOffStack()) {
+    return JNI_ERR;
+  }
+
+  JavaThread* th = (JavaThread*)self;
+  Jnjvm* myvm = th->getJVM();
+  bool isDaemon = finishAttachedThread(myvm);
+  th->detach();
+  if (!isDaemon) myvm->threadSystem.leave();
+  return JNI_OK;
 }
 
 
@@ -4338,6 +4425,11 @@ jint GetEnv(JavaVM *vm, void **env, jint version) {
   JavaObject* obj = 0;
   llvm_gcroot(obj, 0);
 
+  if (!vmkit::Thread::get()->isVmkitThread()) {
+    (*env) = 0;
+    return JNI_EDETACHED;
+  }
+
   BEGIN_JNI_EXCEPTION
 
   JavaThread* _th = JavaThread::get();
@@ -4359,9 +4451,7 @@ jint GetEnv(JavaVM *vm, void **env, jint version) {
 
 
 jint AttachCurrentThreadAsDaemon(JavaVM *vm, void **par1, void *par2) {
-  NYI();
-  abort();
-  return 0;
+  return attachCurrentThread(vm, par1, par2, true);
 }
 
 // Pull in implementation-specific JNI methods
@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <unistd.h>
 #include "debug.h"
 
 #include "vmkit/Thread.h"
@@ -50,14 +51,24 @@ const unsigned int Jnjvm::Magic = 0xcafebabe;
  * See Runtime.addShutdownHook
  * In GNUClasspath the default behavior when the program call System.exit
  * is to execute such a code.
- * Hence, the only mission of this thread is to call System.exit when
- * the user press Ctrl_C
+ * Hence, the main mission of this thread is to call System.exit when
+ * the user press Ctrl_C. It also writes the lock profile on SIGQUIT.
  */
 void threadToDetectCtrl_C(vmkit::Thread* th) {
 	while (!vmkit::finishForCtrl_C) {
-		vmkit::lockForCtrl_C.lock();
-		vmkit::condForCtrl_C.wait(&vmkit::lockForCtrl_C);
-		vmkit::lockForCtrl_C.unlock(th);
+		if (vmkit::dumpForSigQuit) {
+			vmkit::dumpForSigQuit = false;
+			th->MyVM->dumpLockProfile();
+			continue;
+		}
+		// Handlers set their flag before writing to the pipe, so a signal
+		// received after the flags were read leaves a byte to read.
+		char c;
+		th->enterUncooperativeCode();
+		if (read(vmkit::pipeForCtrl_C[0], &c, 1) < 0) {
+			// Interrupted, look at the flags again.
+		}
+		th->leaveUncooperativeCode();
 	}
 	JavaThread* kk = (JavaThread*)th;
 	UserClass* cl = kk->getJVM()->upcalls->SystemClass;
@@ -905,6 +916,22 @@ void ClArgumentsInfo::extractClassFromJar(Jnjvm* vm, int argc, char** argv,
   }
 }
 
+/// parseMemorySize - Parse a size such as 512k or 1m. Returns 0 if the
+/// string is not a valid size.
+static word_t parseMemorySize(const char* value) {
+  char* end = NULL;
+  unsigned long long size = strtoull(value, &end, 10);
+  if (end == value) return 0;
+  switch (*end) {
+    case 'g': case 'G': size <<= 30; ++end; break;
+    case 'm': case 'M': size <<= 20; ++end; break;
+    case 'k': case 'K': size <<= 10; ++end; break;
+    default: break;
+  }
+  if (*end != 0) return 0;
+  return (word_t)size;
+}
+
 void ClArgumentsInfo::nyi() {
   fprintf(stdout, "Not yet implemented\n");
 }
@@ -1036,8 +1063,14 @@ void ClArgumentsInfo::readArgs(Jnjvm* vm) {
       nyi();
     } else if (!(strcmp(cur, "-mx"))) {
       nyi();
-    } else if (!(strcmp(cur, "-ss"))) {
-      nyi();
+    } else if (!(strncmp(cur, "-Xss", 4)) || !(strncmp(cur, "-ss", 3))) {
+      char* value = cur[1] == 'X' ? &cur[4] : &cur[3];
+      word_t size = parseMemorySize(value);
+      if (size == 0) {
+        printInformation();
+      } else {
+        vmkit::Thread::setDefaultStackSize(size);
+      }
     } else if (!(strcmp(cur, "-verbose"))) {
       nyi();
     } else if (!(strcmp(cur, "-verbose:class"))) {
@@ -1056,6 +1089,37 @@ void ClArgumentsInfo::readArgs(Jnjvm* vm) {
       printInformation();
     } else if (!(strcmp(cur, "-help"))) {
       printInformation();
+    } else if (!(strcmp(cur, "-X:safepoint:poll=page"))) {
+      // Methods compiled before this point keep polling doYield, which the
+      // rendezvous still sets.
+      if (!vm->rendezvous.enablePollingPage()) {
+        fprintf(stderr, "Page based safe points are not supported on this "
+                        "platform, using doYield polling\n");
+      }
+    } else if (!(strcmp(cur, "-X:safepoint:poll=flag"))) {
+    } else if (!(strncmp(cur, "-X:safepoint:log=", 17))) {
+      if (!vm->rendezvous.openSafepointLog(&cur[17])) {
+        fprintf(stderr, "Can not open safepoint log %s\n", &cur[17]);
+      }
+    } else if (!(strcmp(cur, "-X:locks:biased=on"))) {
+      vmkit::ThinLock::BiasedLocking = true;
+    } else if (!(strcmp(cur, "-X:locks:biased=off"))) {
+      // Locks already biased lose their bias when their owner releases
+      // them.
+      vmkit::ThinLock::BiasedLocking = false;
+    } else if (!(strncmp(cur, "-X:locks:profile=", 17))) {
+      if (!vm->lockSystem.profiler.open(&cur[17])) {
+        fprintf(stderr, "Can not open lock profile %s\n", &cur[17]);
+      }
+    } else if (!(strncmp(cur, "-X:locks:profile:sample=", 24))) {
+      vm->lockSystem.profiler.setSampleRate(atoi(&cur[24]));
+    } else if (!(strncmp(cur, "-X:affinity:", 12))) {
+      if (vmkit::ThreadAffinity::parse(&cur[12])) {
+        // This thread is already running.
+        vmkit::ThreadAffinity::apply(vmkit::ThreadAffinity::Mutator);
+      } else {
+        fprintf(stderr, "Invalid affinity %s\n", &cur[12]);
+      }
     } else if (!(strcmp(cur, "-X"))) {
       nyi();
     } else if (!(strcmp(cur, "-agentlib"))) {
@@ -1109,6 +1173,8 @@ void Jnjvm::loadBootstrap() {
   referenceThread = new JavaReferenceThread(this);
   referenceThread->start(
       (void (*)(vmkit::Thread*))JavaReferenceThread::enqueueStart);
+
+  vmkit::Collector::startCollectorThreads(this);
   
   // Initialize the bootstrap class loader if it's not
   // done already.
@@ -1342,8 +1408,10 @@ void Jnjvm::runApplication(int argc, char** argv) {
   mainThread = new JavaThread(this);
   mainThread->start((void (*)(vmkit::Thread*))mainJavaStart);
 
-  JavaThread* th = new JavaThread(this);
-  th->start((void (*)(vmkit::Thread*))threadToDetectCtrl_C);
+  if (pipe(vmkit::pipeForCtrl_C) == 0) {
+    JavaThread* th = new JavaThread(this);
+    th->start((void (*)(vmkit::Thread*))threadToDetectCtrl_C);
+  }
 }
 
 Jnjvm::Jnjvm(vmkit::BumpPtrAllocator& Alloc,
@@ -1356,7 +1424,8 @@ Jnjvm::Jnjvm(vmkit::BumpPtrAllocator& Alloc,
   
   appClassLoader = NULL;
   jniEnv = &JNI_JNIEnvTable;
-  javavmEnv = &JNI_JavaVMTable;
+  javavmEnv.functions = &JNI_JavaVMTable;
+  javavmEnv.vm = this;
   
   bootstrapLoader = loader;
   upcalls = bootstrapLoader->upcalls;
@@ -1396,6 +1465,14 @@ void Jnjvm::endCollection() {
   finalizerThread->FinalizationCond.broadcast();
   referenceThread->EnqueueCond.broadcast();
 }
+
+void Jnjvm::deflateIdleLocks() {
+  lockSystem.deflateIdleLocks();
+}
+
+void Jnjvm::dumpLockProfile() {
+  lockSystem.profiler.dump(this);
+}
   
 void Jnjvm::scanWeakReferencesQueue(word_t closure) {
   referenceThread->WeakReferencesQueue.scan(referenceThread, closure);
@@ -1407,6 +1484,9 @@ void Jnjvm::scanSoftReferencesQueue(word_t closure) {
   
 void Jnjvm::scanPhantomReferencesQueue(word_t closure) {
   referenceThread->PhantomReferencesQueue.scan(referenceThread, closure);
+  // Finalization may resurrect objects, and a resurrected object still names
+  // its fat lock in its header: scan the locks once liveness is final.
+  lockSystem.scanLocks(closure);
 }
 
 void Jnjvm::scanFinalizationQueue(word_t closure) {
@@ -1530,14 +1610,15 @@ extern "C" int StartJnjvmWithoutJIT(int argc, char** argv, char* mainClass) {
   return 0; 
 }
 
-void Jnjvm::printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr) {
+void Jnjvm::printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr,
+                        FILE* out) {
   if (FI->Metadata == NULL) {
-    vmkit::MethodInfoHelper::print(ip, addr);
+    vmkit::MethodInfoHelper::print(ip, addr, out);
     return;
   }
   JavaMethod* meth = (JavaMethod*)FI->Metadata;
 
-  fprintf(stderr, "; %p (%p) in %s.%s (line %d, bytecode %d, code start %p)",
+  fprintf(out, "; %p (%p) in %s.%s (line %d, bytecode %d, code start %p)",
           (void*)ip,
           (void*)addr,
           UTF8Buffer(meth->classDef->name).cString(),
@@ -1545,7 +1626,7 @@ void Jnjvm::printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr) {
           meth->lookupLineNumber(FI),
           FI->SourceIndex, meth->code);
 
-  fprintf(stderr, "\n");
+  fprintf(out, "\n");
 }
 
 void Jnjvm::printBacktrace()
@@ -128,6 +128,8 @@ private:
 
   virtual void startCollection();
   virtual void endCollection();
+  virtual void deflateIdleLocks();
+  virtual void dumpLockProfile();
   virtual void scanWeakReferencesQueue(word_t closure);
   virtual void scanSoftReferencesQueue(word_t closure);
   virtual void scanPhantomReferencesQueue(word_t closure);
@@ -141,7 +143,8 @@ private:
   virtual size_t getObjectSize(gc* obj);
   virtual const char* getObjectTypeName(gc* obj);
   virtual bool isCorruptedType(gc* header);
-  virtual void printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr);
+  virtual void printMethod(vmkit::FrameInfo* FI, word_t ip, word_t addr,
+                           FILE* out = stderr);
   virtual void invokeEnqueueReference(gc* res);
   virtual void clearObjectReferent(gc* ref);
   virtual gc** getObjectReferentPtr(gc* _obj);
@@ -193,6 +196,20 @@ public:
   /// tracer - Traces instances of this class.
   ///
   virtual void tracer(word_t closure);
+
+  /// NbClassPackets - The number of root packets of the bootstrap classes.
+  ///
+  static const uint32 NbClassPackets = 8;
+
+  /// getNbRootPackets - The class packets, and one packet for each of the
+  /// other roots: loaders and strings, JNI globals, and pending finalizations
+  /// and references.
+  ///
+  virtual uint32_t getNbRootPackets();
+
+  /// traceRootPacket - Traces one packet of the roots.
+  ///
+  virtual void traceRootPacket(uint32_t packet, word_t closure);
   
   /// dirSeparator - Directory separator for file paths, e.g. '\' for windows,
   /// '/' for Unix.
@@ -233,9 +250,17 @@ public:
   ///
   void* jniEnv;
 
+  /// JavaVMEnv - What a JavaVM of this JVM points to: the JNI invoke
+  /// interface, followed by the JVM for the invoke functions.
+  ///
+  struct JavaVMEnv {
+    const void* functions;
+    Jnjvm* vm;
+  };
+
   /// javavmEnv - The Java VM environment of this JVM.
   ///
-  const void* javavmEnv;
+  JavaVMEnv javavmEnv;
 
   /// postProperties - Properties set at runtime and in command line.
   ///
@@ -175,6 +175,7 @@ JnjvmBootstrapLoader::JnjvmBootstrapLoader(vmkit::BumpPtrAllocator& Alloc,
   VMFloatName = asciizConstructUTF8("java/lang/VMFloat");
   VMDoubleName = asciizConstructUTF8("java/lang/VMDouble");
   stackWalkerName = asciizConstructUTF8("gnu/classpath/VMStackWalker");
+  unsafeName = asciizConstructUTF8("sun/misc/Unsafe");
   NoClassDefFoundError = asciizConstructUTF8("java/lang/NoClassDefFoundError");
 
 #define DEF_UTF8(var) \
@@ -208,6 +209,7 @@ JnjvmBootstrapLoader::JnjvmBootstrapLoader(vmkit::BumpPtrAllocator& Alloc,
   DEF_UTF8(doubleToRawLongBits);
   DEF_UTF8(intBitsToFloat);
   DEF_UTF8(longBitsToDouble);
+  DEF_UTF8(monitorEnter);
 
 #undef DEF_UTF8 
 }
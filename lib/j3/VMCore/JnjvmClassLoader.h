@@ -170,6 +170,16 @@ public:
   /// tracer - Traces a JnjvmClassLoader for GC.
   ///
   virtual void tracer(word_t closure);
+
+  /// traceClasses - Traces the classes in one of nbSlices bucket ranges of
+  /// the class map, so that collectors can share the classes of a loader.
+  ///
+  void traceClasses(word_t closure, uint32 slice, uint32 nbSlices);
+
+  /// traceStrings - Traces the strings of the class files and the Java
+  /// object of the class loader.
+  ///
+  void traceStrings(word_t closure);
   
   /// getJnjvmLoaderFromJavaObject - Return the Jnjvm runtime representation
   /// of the given class loader.
@@ -382,6 +392,11 @@ public:
   ///
   virtual void tracer(word_t closure);
 
+  /// tracePrimitiveClasses - Traces the delegatees of the primitive classes,
+  /// which are not in the class map.
+  ///
+  void tracePrimitiveClasses(word_t closure);
+
   /// libClasspathEnv - The paths for dynamic libraries of Classpath, separated
   /// by ':'.
   ///
@@ -422,6 +437,7 @@ public:
   const UTF8* VMFloatName;
   const UTF8* VMDoubleName;
   const UTF8* stackWalkerName;
+  const UTF8* unsafeName;
   const UTF8* abs;
   const UTF8* sqrt;
   const UTF8* sin;
@@ -450,6 +466,7 @@ public:
   const UTF8* doubleToRawLongBits;
   const UTF8* intBitsToFloat;
   const UTF8* longBitsToDouble;
+  const UTF8* monitorEnter;
 
   /// primitiveMap - Map of primitive classes, hashed by id.
   std::map<const char, UserClassPrimitive*> primitiveMap;
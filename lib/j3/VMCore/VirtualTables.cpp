@@ -223,14 +223,27 @@ void Class::tracer(word_t closure) {
 //===----------------------------------------------------------------------===//
 
 void JnjvmClassLoader::tracer(word_t closure) {
-  
-  for (ClassMap::iterator i = classes->map.begin(), e = classes->map.end();
-       i!= e; ++i) {
+  traceClasses(closure, 0, 1);
+  traceStrings(closure);
+}
+
+void JnjvmClassLoader::traceClasses(word_t closure, uint32 slice,
+                                    uint32 nbSlices) {
+  // Each slice owns a contiguous range of buckets, so that collectors do not
+  // walk the buckets of the other slices.
+  uint64 size = classes->map.NumBuckets;
+  ClassMap::iterator::pointer first =
+    classes->map.Buckets + size * slice / nbSlices;
+  ClassMap::iterator::pointer last =
+    classes->map.Buckets + size * (slice + 1) / nbSlices;
+  for (ClassMap::iterator i(first, last), e(last, last); i != e; ++i) {
     CommonClass* cl = i->second;
     if (cl->isClass()) cl->asClass()->tracer(closure);
     else cl->tracer(closure);
   }
-  
+}
+
+void JnjvmClassLoader::traceStrings(word_t closure) {
   StringList* end = strings;
   while (end != NULL) {
     for (uint32 i = 0; i < end->length; ++i) {
@@ -244,8 +257,11 @@ void JnjvmClassLoader::tracer(word_t closure) {
 }
 
 void JnjvmBootstrapLoader::tracer(word_t closure) {
- 
   JnjvmClassLoader::tracer(closure);
+  tracePrimitiveClasses(closure);
+}
+
+void JnjvmBootstrapLoader::tracePrimitiveClasses(word_t closure) {
   upcalls->OfVoid->tracer(closure);
   upcalls->OfBool->tracer(closure);
   upcalls->OfByte->tracer(closure);
@@ -272,61 +288,63 @@ void JnjvmBootstrapLoader::tracer(word_t closure) {
 
 
 void Jnjvm::tracer(word_t closure) {
-  JavaObject* jThread = NULL;
-  llvm_gcroot(jThread, 0);
-
-  // (1) Trace the bootstrap loader.
-  bootstrapLoader->tracer(closure);
-  
-  // (2) Trace the application class loader.
-  if (appClassLoader != NULL) {
-    vmkit::Collector::markAndTraceRoot(NULL,
-        appClassLoader->getJavaClassLoaderPtr(), closure);
-  }
-  
-  // (3) Trace JNI global references.
-  JNIGlobalReferences* start = &globalRefs;
-  while (start != NULL) {
-    for (uint32 i = 0; i < start->length; ++i) {
-      JavaObject** obj = start->globalReferences + i;
-      vmkit::Collector::markAndTraceRoot(NULL, obj, closure);
-    }
-    start = start->next;
-  }
-  
-  // (4) Trace the finalization queue.
-  for (uint32 i = 0; i < finalizerThread->CurrentFinalizedIndex; ++i) {
-    vmkit::Collector::markAndTraceRoot(NULL, finalizerThread->ToBeFinalized + i, closure);
+  for (uint32 i = 0; i < getNbRootPackets(); ++i) {
+    traceRootPacket(i, closure);
   }
-  
-  // (5) Trace the reference queue
-  for (uint32 i = 0; i < referenceThread->ToEnqueueIndex; ++i) {
-    vmkit::Collector::markAndTraceRoot(NULL, referenceThread->ToEnqueue + i, closure);
+}
+
+uint32_t Jnjvm::getNbRootPackets() {
+  return NbClassPackets + 3;
+}
+
+void Jnjvm::traceRootPacket(uint32_t packet, word_t closure) {
+  // (1) Trace the bootstrap loader. Its classes, with their static fields,
+  // are the bulk of the roots, so they are split in several packets.
+  if (packet < NbClassPackets) {
+    bootstrapLoader->traceClasses(closure, packet, NbClassPackets);
+    return;
   }
- 
-  // (6) Trace the locks and their associated object.
-  uint32 i = 0;
-  for (; i < vmkit::LockSystem::GlobalSize; i++) {
-    vmkit::FatLock** array = lockSystem.LockTable[i];
-    if (array == NULL) break;
-    uint32 j = 0;
-    for (; j < vmkit::LockSystem::IndexSize; j++) {
-      if (array[j] == NULL) break;
-      vmkit::FatLock* lock = array[j];
-      jThread = NULL;
-      if (vmkit::Thread *th = lock->getOwner()) {
-        if (th->isVmkitThread())
-          jThread = ((JavaThread*)th)->currentThread();
+
+  switch (packet - NbClassPackets) {
+    case 0:
+      bootstrapLoader->traceStrings(closure);
+      bootstrapLoader->tracePrimitiveClasses(closure);
+
+      // (2) Trace the application class loader.
+      if (appClassLoader != NULL) {
+        vmkit::Collector::markAndTraceRoot(NULL,
+            appClassLoader->getJavaClassLoaderPtr(), closure);
       }
-      vmkit::Collector::markAndTraceRoot(jThread, lock->getAssociatedObjectPtr(), closure);
-    }
-    for (j = j + 1; j < vmkit::LockSystem::IndexSize; j++) {
-      assert(array[j] == NULL);
+      break;
+
+    case 1: {
+      // (3) Trace JNI global references.
+      JNIGlobalReferences* start = &globalRefs;
+      while (start != NULL) {
+        for (uint32 i = 0; i < start->length; ++i) {
+          JavaObject** obj = start->globalReferences + i;
+          vmkit::Collector::markAndTraceRoot(NULL, obj, closure);
+        }
+        start = start->next;
+      }
+      break;
     }
+
+    case 2:
+      // (4) Trace the finalization queue.
+      for (uint32 i = 0; i < finalizerThread->CurrentFinalizedIndex; ++i) {
+        vmkit::Collector::markAndTraceRoot(NULL, finalizerThread->ToBeFinalized + i, closure);
+      }
+
+      // (5) Trace the reference queue
+      for (uint32 i = 0; i < referenceThread->ToEnqueueIndex; ++i) {
+        vmkit::Collector::markAndTraceRoot(NULL, referenceThread->ToEnqueue + i, closure);
+      }
+      break;
   }
-  for (i = i + 1; i < vmkit::LockSystem::GlobalSize; i++) {
-    assert(lockSystem.LockTable[i] == NULL);
-  }
+
+  // The locks do not keep their associated object alive, see
+  // scanPhantomReferencesQueue.
 }
 
 void JavaThread::tracer(word_t closure) {
@@ -8,22 +8,31 @@
 //===----------------------------------------------------------------------===//
 
 #include <cassert>
+#include <climits>
 #include <signal.h>
+#include <sys/mman.h>
 #include "VmkitGC.h"
 #include "vmkit/VirtualMachine.h"
 #include "vmkit/CollectionRV.h"
+#include "vmkit/MethodInfo.h"
 
 #include "debug.h"
 
 namespace vmkit {
 
+// The rendezvous does not use any lock. A thread is counted exactly once by
+// whoever flips its joinedRV flag: either the initiator, when it finds the
+// thread in uncooperative code, or the thread itself when it joins. Threads
+// that joined sleep on rvEpoch, and the initiator sleeps on nbJoined.
+
 void CollectionRV::another_mark() {
   vmkit::Thread* th = vmkit::Thread::get();
   assert(th->getLastSP() != 0);
-  assert(nbJoined < th->MyVM->numberOfThreads);
-  nbJoined++;
-  if (nbJoined == th->MyVM->numberOfThreads) {
-    condInitiator.broadcast();
+  int32_t joined = __sync_add_and_fetch(&nbJoined, 1);
+  assert(joined <= (int32_t)th->MyVM->numberOfThreads);
+  if (joined == (int32_t)th->MyVM->numberOfThreads) {
+    lastJoined = th;
+    System::FutexWake(&nbJoined, 1);
   }
 }
 
@@ -31,45 +40,254 @@ void CollectionRV::waitEndOfRV() {
   vmkit::Thread* th = vmkit::Thread::get();
   assert(th->getLastSP() != 0);
 
+  int32_t epoch = rvEpoch;
+  __sync_synchronize();
   while (th->doYield) {
-    condEndRV.wait(&_lockRV);
+    System::FutexWait(&rvEpoch, epoch);
+    epoch = rvEpoch;
+    __sync_synchronize();
   }
 }
 
 void CollectionRV::waitRV() {
   vmkit::Thread* self = vmkit::Thread::get(); 
+  int32_t total = self->MyVM->numberOfThreads;
   // Add myself.
-  nbJoined++;
-
-  //fprintf(stderr, "waitRV: %d from %d\n", nbJoined, self->MyVM->numberOfThreads);
-
-  while (nbJoined != self->MyVM->numberOfThreads) {
-	  vmkit::Thread* cur = self;
-	  //fprintf(stderr, "Wasting time : ");
-	    for (cur = (vmkit::Thread*)self->next(); cur != self;
-	         cur = (vmkit::Thread*)cur->next()) {
-//	      if (!cur->getLastSP() && cur != self) {
-//	        fprintf(stderr, "%p,", cur);
-//	      }
-	    }
-//	    fprintf(stderr, "\n");
-    condInitiator.wait(&_lockRV);
+  int32_t joined = __sync_add_and_fetch(&nbJoined, 1);
+  if (joined == total) lastJoined = self;
+
+  while (joined != total) {
+    System::FutexWait(&nbJoined, joined);
+    joined = nbJoined;
   } 
 }
 
+/// joinAndWait - Count the thread in the current rendezvous, unless the
+/// initiator already did, and wait for the end of the rendezvous. The thread
+/// must have its lastSP set.
+void CollectionRV::joinAndWait(Thread* th) {
+  assert(th->getLastSP() && "Joining a rendezvous without a SP");
+  while (th->doYield) {
+    if (th->handshakeState != Thread::kHandshakeNone) {
+      joinHandshake(th);
+      continue;
+    }
+    if (__sync_bool_compare_and_swap(&(th->joinedRV), false, true)) {
+      if (!th->doYield) {
+        // The rendezvous finished in between: we claimed the flag of the
+        // next one. Give it back and look again.
+        th->joinedRV = false;
+        __sync_synchronize();
+        continue;
+      }
+      if (safepointLog != NULL) {
+        recordTimeToSafepoint(th, System::GetNanoTime() - record.startTime);
+      }
+      another_mark();
+    }
+    waitEndOfRV();
+  }
+}
+
+// A handshake takes the initiator slot like a rendezvous, but only sets the
+// doYield flag, and protects the polling page, of its target. The target
+// runs the operation itself when it reaches a safe point, or the requester
+// runs it if the target is in uncooperative code: the target can not leave
+// it while doYield is set.
+
+void CollectionRV::handshake(Thread* target, HandshakeClosure* closure) {
+  vmkit::Thread* self = vmkit::Thread::get();
+  assert(self != target && "Handshake with self");
+
+  while (!__sync_bool_compare_and_swap(&initiator, NULL, self)) {
+    // Take part in the rendezvous or handshake that owns the slot.
+    if (self->doYield) join();
+    else sched_yield();
+  }
+
+  handshakeTarget = target;
+  target->handshakeOp = closure;
+  target->handshakeState = Thread::kHandshakePending;
+  __sync_synchronize();
+  target->doYield = true;
+  __sync_synchronize();
+  // Code polling the page does not read doYield. Other threads keep
+  // running: their pages stay readable.
+  protectPollingPage(target);
+
+  // The target does not wake us up when entering uncooperative code, so
+  // look at its lastSP regularly.
+  struct timespec timeout = { 0, 100000 };
+  while (true) {
+    int32_t state = target->handshakeState;
+    if (state == Thread::kHandshakeDone) break;
+    if (state == Thread::kHandshakePending && target->getLastSP() &&
+        __sync_bool_compare_and_swap(&(target->handshakeState),
+                                     Thread::kHandshakePending,
+                                     Thread::kHandshakeRunning)) {
+      closure->doThread(target);
+      break;
+    }
+    System::FutexWait(&(target->handshakeState), state, &timeout);
+  }
+
+  unprotectPollingPage(target);
+  // Clear doYield before releasing the target, so that it can tell a
+  // rendezvous started after this handshake from this handshake.
+  target->doYield = false;
+  __sync_synchronize();
+  target->handshakeOp = NULL;
+  target->handshakeState = Thread::kHandshakeNone;
+  System::FutexWake(&(target->handshakeState), 1);
+  handshakeTarget = NULL;
+  __sync_synchronize();
+  initiator = NULL;
+}
+
+/// joinHandshake - Called by the target of a handshake at a safe point,
+/// with its lastSP set. Runs the operation unless the requester already
+/// does, and waits until the requester releases the thread.
+void CollectionRV::joinHandshake(Thread* th) {
+  if (__sync_bool_compare_and_swap(&(th->handshakeState),
+                                   Thread::kHandshakePending,
+                                   Thread::kHandshakeRunning)) {
+    th->handshakeOp->doThread(th);
+    th->handshakeState = Thread::kHandshakeDone;
+    System::FutexWake(&(th->handshakeState), 1);
+  }
+
+  int32_t state = th->handshakeState;
+  while (state != Thread::kHandshakeNone) {
+    System::FutexWait(&(th->handshakeState), state);
+    state = th->handshakeState;
+  }
+}
+
+bool CollectionRV::enablePollingPage() {
+  if (!System::SupportsHardwareSafepointPoll()) return false;
+  pollingPages = true;
+  return true;
+}
+
+void CollectionRV::protectPollingPage(Thread* th) {
+  if (pollingPages) {
+    mprotect((void*)th->GetPollingPage(), System::GetPageSize(), PROT_NONE);
+  }
+}
+
+void CollectionRV::unprotectPollingPage(Thread* th) {
+  if (pollingPages) {
+    mprotect((void*)th->GetPollingPage(), System::GetPageSize(),
+             PROT_READ | PROT_WRITE);
+  }
+}
+
+bool CollectionRV::openSafepointLog(const char* name) {
+  FILE* file = fopen(name, "w");
+  if (file == NULL) return false;
+  safepointLog = file;
+  return true;
+}
+
+void CollectionRV::recordTimeToSafepoint(Thread* th, uint64_t delay) {
+  uint64_t limit = 10000;
+  uint32_t bucket = 0;
+  while (bucket < Thread::kSafepointBuckets - 1 && delay >= limit) {
+    limit *= 10;
+    bucket++;
+  }
+  th->safepointHistogram[bucket]++;
+}
+
+/// recordSlowestThread - Called by the initiator once all threads joined.
+/// Exactly one thread, the one whose count completed the rendezvous, sets
+/// lastJoined, but the initiator may see the count before the store.
+void CollectionRV::recordSlowestThread() {
+  vmkit::Thread* self = vmkit::Thread::get();
+  while (lastJoined == NULL) sched_yield();
+
+  record.timeToSafepoint = System::GetNanoTime() - record.startTime;
+  record.nbThreads = self->MyVM->numberOfThreads;
+  record.slowest = lastJoined != self ? lastJoined : NULL;
+  record.frame = NULL;
+  record.ip = 0;
+  record.addr = 0;
+
+  if (record.slowest != NULL) {
+    // The thread is stopped with its lastSP set, so its stack can be walked.
+    StackWalker Walker(record.slowest);
+    while (FrameInfo* FI = Walker.get()) {
+      if (FI->Metadata != NULL) {
+        record.frame = FI;
+        record.ip = Walker.ip;
+        record.addr = Walker.addr;
+        break;
+      }
+      ++Walker;
+    }
+  }
+}
+
+void CollectionRV::logRendezvous(Thread* self) {
+  fprintf(safepointLog,
+          "rendezvous %llu: initiator %p, %u threads, time to safepoint %llu us",
+          (unsigned long long)nbRendezvous++, (void*)self, record.nbThreads,
+          (unsigned long long)(record.timeToSafepoint / 1000));
+  if (record.slowest == NULL) {
+    fprintf(safepointLog, "\n");
+  } else if (record.frame == NULL) {
+    fprintf(safepointLog, ", slowest thread %p\n", (void*)record.slowest);
+  } else {
+    fprintf(safepointLog, ", slowest thread %p at\n", (void*)record.slowest);
+    self->MyVM->printMethod(record.frame, record.ip, record.addr,
+                            safepointLog);
+  }
+  fflush(safepointLog);
+}
+
+void CollectionRV::logThreadHistogram(Thread* th) {
+  if (safepointLog == NULL) return;
+  uint32_t* histogram = th->safepointHistogram;
+  fprintf(safepointLog, "thread %p: <10us %u, <100us %u, <1ms %u, "
+          "<10ms %u, <100ms %u, >=100ms %u\n", (void*)th,
+          histogram[0], histogram[1], histogram[2],
+          histogram[3], histogram[4], histogram[5]);
+  fflush(safepointLog);
+}
+
+void CollectionRV::dumpSafepointHistograms() {
+  if (safepointLog == NULL) return;
+  vmkit::Thread* self = vmkit::Thread::get();
+  self->MyVM->threadLock.lock();
+  vmkit::Thread* cur = self;
+  do {
+    logThreadHistogram(cur);
+    cur = (vmkit::Thread*)cur->next();
+  } while (cur != self);
+  self->MyVM->threadLock.unlock();
+}
+
 void CooperativeCollectionRV::synchronize() {
   assert(nbJoined == 0);
   vmkit::Thread* self = vmkit::Thread::get();
+  assert(initiator == self && "Synchronizing without being the initiator");
   // Lock thread lock, so that we can traverse the thread list safely. This will
   // be released on finishRV.
   self->MyVM->threadLock.lock();
 
+  if (safepointLog != NULL) {
+    lastJoined = NULL;
+    record.startTime = System::GetNanoTime();
+  }
+
+  // Threads polling their page fault once it is protected, and see doYield
+  // set.
   vmkit::Thread* cur = self;
-  assert(initiator == NULL);
-  initiator = self;
   do {
     cur->doYield = true;
     assert(!cur->joinedRV);
+    __sync_synchronize();
+    protectPollingPage(cur);
     cur = (vmkit::Thread*)cur->next();
   } while (cur != self);
  
@@ -79,36 +297,41 @@ void CooperativeCollectionRV::synchronize() {
   // Lookup currently blocked threads.
   for (cur = (vmkit::Thread*)self->next(); cur != self; 
        cur = (vmkit::Thread*)cur->next()) {
-    if (cur->getLastSP()) {
-      nbJoined++;
-      cur->joinedRV = true;
+    if (cur->getLastSP() &&
+        __sync_bool_compare_and_swap(&(cur->joinedRV), false, true)) {
+      if (safepointLog != NULL) recordTimeToSafepoint(cur, 0);
+      __sync_add_and_fetch(&nbJoined, 1);
     }
   }
   
-//  fprintf(stderr, "synchronize: %d from %d\n", nbJoined, self->MyVM->numberOfThreads);
-
   // And wait for other threads to finish.
   waitRV();
 
-  // Unlock, so that threads in uncooperative code that go back to cooperative
-  // code can set back their lastSP.
-  unlockRV();
+  if (safepointLog != NULL) recordSlowestThread();
 }
 
 void CooperativeCollectionRV::join() {
   vmkit::Thread* th = vmkit::Thread::get();
-  assert(th->doYield && "No yield");
   assert((th->getLastSP() == 0) && "SP present in cooperative code");
 
   th->inRV = true;
-  
-  lockRV();
-  th->setLastSP(System::GetCallerAddress());
-  th->joinedRV = true;
-  another_mark();
-  waitEndOfRV();
-  th->setLastSP(0);
-  unlockRV();
+
+  // A thread that lost the race to initiate a collection may get here before
+  // the initiator asked it to yield. A handshake only stops its target.
+  while (!th->doYield && initiator != NULL && handshakeTarget == NULL) {
+    sched_yield();
+  }
+
+  word_t SP = System::GetCallerAddress();
+  while (th->doYield) {
+    th->setLastSP(SP);
+    __sync_synchronize();
+    joinAndWait(th);
+    // A new rendezvous may have started before lastSP was cleared, so look
+    // at doYield again after the barrier.
+    th->setLastSP(0);
+    __sync_synchronize();
+  }
   
   th->inRV = false;
 }
@@ -119,17 +342,7 @@ void CooperativeCollectionRV::joinBeforeUncooperative() {
          "SP not set before entering uncooperative code");
 
   th->inRV = true;
-  
-  lockRV();
-  if (th->doYield) {
-    if (!th->joinedRV) {
-      th->joinedRV = true;
-      another_mark();
-    }
-    waitEndOfRV();
-  }
-  unlockRV();
-
+  joinAndWait(th);
   th->inRV = false;
 }
 
@@ -139,19 +352,13 @@ void CooperativeCollectionRV::joinAfterUncooperative(word_t SP) {
          "SP set after entering uncooperative code");
 
   th->inRV = true;
-
-  lockRV();
-  if (th->doYield) {
+  while (th->doYield) {
     th->setLastSP(SP);
-    if (!th->joinedRV) {
-      th->joinedRV = true;
-      another_mark();
-    }
-    waitEndOfRV();
+    __sync_synchronize();
+    joinAndWait(th);
     th->setLastSP(0);
+    __sync_synchronize();
   }
-  unlockRV();
-
   th->inRV = false;
 }
 
@@ -161,25 +368,30 @@ extern "C" void conditionalSafePoint() {
 }
 
 void CooperativeCollectionRV::finishRV() {
-  lockRV();
-  
-  assert(vmkit::Thread::get() == initiator);
-  vmkit::Thread* cur = initiator;
+  vmkit::Thread* self = vmkit::Thread::get();
+  assert(self == initiator);
+  vmkit::Thread* cur = self;
   do {
     assert(cur->doYield && "Inconsistent state");
     assert(cur->joinedRV && "Inconsistent state");
+    // A thread that faults before this sees doYield set and joins.
+    unprotectPollingPage(cur);
     cur->doYield = false;
     cur->joinedRV = false;
     cur = (vmkit::Thread*)cur->next();
-  } while (cur != initiator);
+  } while (cur != self);
 
-  assert(nbJoined == initiator->MyVM->numberOfThreads && "Inconsistent state");
+  assert(nbJoined == (int32_t)self->MyVM->numberOfThreads &&
+         "Inconsistent state");
   nbJoined = 0;
-  initiator->MyVM->threadLock.unlock();
-  condEndRV.broadcast();
+  self->MyVM->threadLock.unlock();
   initiator = NULL;
-  unlockRV();
-  vmkit::Thread::get()->inRV = false;
+  __sync_add_and_fetch(&rvEpoch, 1);
+  System::FutexWake(&rvEpoch, INT_MAX);
+  self->inRV = false;
+
+  // Threads are running again, write the log outside of the pause.
+  if (safepointLog != NULL) logRendezvous(self);
 }
 
 void CooperativeCollectionRV::addThread(Thread* th) {
@@ -7,10 +7,12 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
 
 #include "vmkit/Cond.h"
 #include "vmkit/Locks.h"
+#include "vmkit/MethodInfo.h"
 #include "vmkit/ObjectLocks.h"
 #include "vmkit/Thread.h"
 #include "vmkit/VirtualMachine.h"
@@ -18,6 +20,7 @@
 #include <cerrno>
 #include <sys/time.h>
 #include <pthread.h>
+#include <vector>
 
 #include "../../j3/VMCore/JavaObject.h"
 #include "../../j3/VMCore/JavaClass.h"
@@ -25,6 +28,193 @@
 
 namespace vmkit {
 
+/// Spin budgets - A thread that finds a thin lock held by another thread
+/// spins on it, pausing between reads of the header for exponentially longer.
+/// How long it spins depends on the history of the lock: the budget doubles
+/// each time spinning got the lock and halves each time it did not. Thin locks
+/// have no room for the budget, so budgets live in a table hashed by object
+/// address, and unrelated locks may share one.
+///
+static const uint32_t kLockSlots = 256;
+static const uint32_t kInitialSpins = 1024;
+static const uint32_t kMinSpins = 64;
+static const uint32_t kMaxSpins = 16384;
+static const uint32_t kMaxBackoff = 64;
+static volatile uint32_t SpinBudgets[kLockSlots];
+
+/// Park slots - A thread that spun for its whole budget sleeps on the futex
+/// word of the lock's slot. Releases and inflations that go through this file
+/// wake it. Releases inlined in compiled code do not, so sleeps are bounded,
+/// from kMinPark to kMaxPark nanoseconds.
+///
+struct ParkSlot {
+  volatile int32_t sequence;
+  volatile int32_t waiters;
+};
+static ParkSlot ParkSlots[kLockSlots];
+static const uint64_t kMinPark = 50 * 1000;
+static const uint64_t kMaxPark = 2 * 1000 * 1000;
+
+static uint32_t getLockSlot(gc* object) {
+  llvm_gcroot(object, 0);
+  word_t addr = (word_t)object;
+  return (uint32_t)((addr >> 4) ^ (addr >> 12)) & (kLockSlots - 1);
+}
+
+/// isHeldThin - Whether the header is the one of a thin lock held by some
+/// thread. A biased lock is held if its count is not zero.
+static bool isHeldThin(word_t header) {
+  if (header & ThinLock::FatMask) return false;
+  if (header & ThinLock::BiasedMask) {
+    return (header & ThinLock::ThinCountMask) != 0;
+  }
+  return (header & ~ThinLock::NonLockBitsMask) != 0;
+}
+
+/// spinOnThinLock - Spin while another thread holds the thin lock of the
+/// object, for at most the budget of the lock. Returns true if the lock was
+/// released or inflated in the meantime.
+static bool spinOnThinLock(gc* object, vmkit::Thread* th) {
+  llvm_gcroot(object, 0);
+  static int processors = System::GetNumberOfProcessors();
+  // The owner can not make progress while we spin.
+  if (processors <= 1) return false;
+
+  uint32_t budget = SpinBudgets[getLockSlot(object)];
+  if (budget == 0) budget = kInitialSpins;
+  uint32_t backoff = 1;
+  for (uint32_t spins = 0; spins < budget; spins += backoff) {
+    for (uint32_t i = 0; i < backoff; ++i) System::Pause();
+    if (!isHeldThin(object->header())) return true;
+    if (backoff < kMaxBackoff) backoff <<= 1;
+    if (th->doYield && !th->inRV) th->MyVM->rendezvous.join();
+  }
+  return false;
+}
+
+/// adaptSpinBudget - Record whether spinning on the lock of the object got the
+/// lock. Races between threads only lose an update of a hint.
+static void adaptSpinBudget(gc* object, bool success) {
+  llvm_gcroot(object, 0);
+  uint32_t slot = getLockSlot(object);
+  uint32_t budget = SpinBudgets[slot];
+  if (budget == 0) budget = kInitialSpins;
+  if (success) {
+    budget = budget < kMaxSpins ? budget << 1 : kMaxSpins;
+  } else {
+    budget = budget > kMinSpins ? budget >> 1 : kMinSpins;
+  }
+  SpinBudgets[slot] = budget;
+}
+
+/// parkOnThinLock - Sleep for at most nanos nanoseconds while another thread
+/// holds the thin lock of the object.
+static void parkOnThinLock(gc* object, vmkit::Thread* th, uint64_t nanos) {
+  llvm_gcroot(object, 0);
+  ParkSlot& slot = ParkSlots[getLockSlot(object)];
+  // Announce ourselves before looking at the header, so that a thread that
+  // releases the lock after we looked sees us and wakes us up.
+  __sync_fetch_and_add(&slot.waiters, 1);
+  int32_t sequence = slot.sequence;
+  __sync_synchronize();
+  if (isHeldThin(object->header())) {
+    struct timespec timeout;
+    timeout.tv_sec = nanos / 1000000000;
+    timeout.tv_nsec = nanos % 1000000000;
+    th->enterUncooperativeCode();
+    System::FutexWait(&slot.sequence, sequence, &timeout);
+    th->leaveUncooperativeCode();
+  }
+  __sync_fetch_and_sub(&slot.waiters, 1);
+}
+
+/// unparkThinLock - Wake up the threads parked on the slot of the object. The
+/// header must have changed before, with a barrier.
+static void unparkThinLock(gc* object) {
+  llvm_gcroot(object, 0);
+  ParkSlot& slot = ParkSlots[getLockSlot(object)];
+  if (slot.waiters) {
+    __sync_fetch_and_add(&slot.sequence, 1);
+    System::FutexWake(&slot.sequence, INT32_MAX);
+  }
+}
+
+bool ThinLock::BiasedLocking = true;
+
+/// getBiasOwner - The ID of the thread a biased header belongs to.
+static word_t getBiasOwner(word_t header) {
+  return header & System::GetThreadIDMask() &
+         ~(ThinLock::FatMask | ThinLock::BiasedMask);
+}
+
+/// unbiasedHeader - The thin lock header equivalent to a biased header. The
+/// count of a thin lock starts at 0 for the first hold.
+static word_t unbiasedHeader(word_t header) {
+  word_t count = header & ThinLock::ThinCountMask;
+  if (count == 0) return header & ThinLock::NonLockBitsMask;
+  return getBiasOwner(header) | (count - ThinLock::ThinCountAdd) |
+         (header & ThinLock::NonLockBitsMask);
+}
+
+/// acquireBiased - Take the lock of an object biased towards the current
+/// thread with a plain store. Other biases are revoked, or moved to the
+/// current thread. Returns false if the lock is not biased anymore, or if
+/// another thread holds it and will remove the bias when it releases it.
+static bool acquireBiased(gc* object, LockSystem& table, word_t id) {
+  llvm_gcroot(object, 0);
+  while (true) {
+    word_t header = object->header();
+    if (!(header & ThinLock::BiasedMask)) return false;
+    bool biasable = table.isBiasable(object);
+    if (getBiasOwner(header) == id) {
+      if (biasable &&
+          (header & ThinLock::ThinCountMask) != ThinLock::ThinCountMask) {
+        object->header() = header + ThinLock::ThinCountAdd;
+        return true;
+      }
+    } else if (!biasable && (header & ThinLock::ThinCountMask)) {
+      return false;
+    }
+    ThinLock::revokeBias(object, table, true);
+  }
+}
+
+void ThinLock::revokeBias(gc* object, LockSystem& table, bool acquiring) {
+  llvm_gcroot(object, 0);
+  vmkit::Thread* th = vmkit::Thread::get();
+  uint64_t id = th->getThreadID();
+  word_t header = object->header();
+  if (!(header & BiasedMask)) return;
+
+  if (getBiasOwner(header) == id) {
+    // Only the owner of a bias writes the header.
+    object->header() = unbiasedHeader(header);
+    return;
+  }
+
+  // The owner writes the header without atomic operations, so it must be
+  // stopped. Stop all threads: the owner may have ended, and its ID may
+  // belong to a new thread.
+  CollectionRV& rendezvous = th->MyVM->rendezvous;
+  while (!rendezvous.startRV()) {
+    rendezvous.cancelRV();
+    rendezvous.join();
+  }
+  rendezvous.synchronize();
+
+  header = object->header();
+  if (header & BiasedMask) {
+    if (acquiring && table.recordRevocation(object) &&
+        !(header & ThinCountMask)) {
+      object->header() = (header & ~getBiasOwner(header)) | id;
+    } else {
+      object->header() = unbiasedHeader(header);
+    }
+  }
+
+  rendezvous.finishRV();
+}
+
 void ThinLock::overflowThinLock(gc* object, LockSystem& table) {
   llvm_gcroot(object, 0);
   FatLock* obj = table.allocate(object);
@@ -41,13 +231,12 @@ void ThinLock::overflowThinLock(gc* object, LockSystem& table) {
     yieldedValue = __sync_val_compare_and_swap(&(object->header()), oldValue, newValue);
   } while (((object->header()) & ~NonLockBitsMask) != ID);
   assert(obj->associatedObject == object);
+  unparkThinLock(object);
 }
- 
-/// initialise - Initialise the value of the lock.
+
+/// removeFatLock - Only called during a collection. Deflating on release
+/// raced with threads that had just read the header.
 ///
-#if 0
-// Disable fat lock deflation code in ObjectLocks.cpp
-// Fixes occasional assertion failure when running on multi-core machine.
 void ThinLock::removeFatLock(FatLock* fatLock, LockSystem& table) {
   gc* object = fatLock->associatedObject;
   llvm_gcroot(object, 0);
@@ -57,18 +246,19 @@ void ThinLock::removeFatLock(FatLock* fatLock, LockSystem& table) {
   word_t yieldedValue = 0;
 
   ID = fatLock->getID();
+  assert(fatLock->isIdle() && "Deflating a lock in use");
   do {
     oldValue = object->header();
+    assert((oldValue & ~NonLockBitsMask) == ID);
     newValue = oldValue & NonLockBitsMask;
     yieldedValue = __sync_val_compare_and_swap(&object->header(), oldValue, newValue);
   } while (oldValue != yieldedValue);
-  assert((oldValue & NonLockBitsMask) != ID);
-  fatLock->associatedObject = NULL;
 }
-#endif
   
 FatLock* ThinLock::changeToFatlock(gc* object, LockSystem& table) {
   llvm_gcroot(object, 0);
+  // The current thread holds the lock, so it owns any bias.
+  revokeBias(object, table, false);
   if (!(object->header() & FatMask)) {
     FatLock* obj = table.allocate(object);
     uint32 count = (object->header() & ThinCountMask) >> ThinCountShift;
@@ -83,6 +273,7 @@ FatLock* ThinLock::changeToFatlock(gc* object, LockSystem& table) {
       assert(obj->associatedObject == object);
       yieldedValue = __sync_val_compare_and_swap(&(object->header()), oldValue, newValue);
     } while (((object->header()) & ~NonLockBitsMask) != ID);
+    unparkThinLock(object);
     return obj;
   } else {
     FatLock* res = table.getFatLockFromID(object->header());
@@ -115,11 +306,17 @@ void printDebugMessage(gc* object, LockSystem& table) {
 
 void ThinLock::acquire(gc* object, LockSystem& table) {
   llvm_gcroot(object, 0);
-  uint64_t id = vmkit::Thread::get()->getThreadID();
+  vmkit::Thread* th = vmkit::Thread::get();
+  uint64_t id = th->getThreadID();
   word_t oldValue = 0;
   word_t newValue = 0;
   word_t yieldedValue = 0;
 
+  if ((object->header() & BiasedMask) && acquireBiased(object, table, id)) {
+    assert(owner(object, table) && "Not owner after quitting acquire!");
+    return;
+  }
+
   if ((object->header() & System::GetThreadIDMask()) == id) {
     assert(owner(object, table) && "Inconsistent lock");
     if ((object->header() & ThinCountMask) != ThinCountMask) {
@@ -136,20 +333,34 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
     return;
   }
 
+  // Bias the lock towards this thread, held once.
+  word_t bias = table.isBiasable(object) ? BiasedMask | ThinCountAdd : 0;
   do {
     oldValue = object->header() & NonLockBitsMask;
-    newValue = oldValue | id;
+    newValue = oldValue | id | bias;
     yieldedValue = __sync_val_compare_and_swap(&(object->header()), oldValue, newValue);
   } while ((object->header() & ~NonLockBitsMask) == 0);
 
-  if (((object->header()) & ~NonLockBitsMask) == id) {
+  if (((object->header()) & ~NonLockBitsMask) == (id | bias)) {
     assert(owner(object, table) && "Not owner after quitting acquire!");
     return;
   }
 
+  // The lock is contended, or inflated.
+  uint64_t waitStart = 0;
+  if (table.profiler.sample()) {
+    table.profiler.startWait(object);
+    waitStart = System::GetNanoTime();
+  }
+
   // Simple counter to lively diagnose possible dead locks in this code.
   int counter = 0;  
+  uint64_t parkNanos = kMinPark;
   while (true) {
+    if ((object->header() & BiasedMask) && acquireBiased(object, table, id)) {
+      break;
+    }
+
     if (object->header() & FatMask) {
       FatLock* obj = table.getFatLockFromID(object->header());
       if (obj != NULL) {
@@ -165,14 +376,32 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
     counter++;
     if (counter == 1000) printDebugMessage(object, table);
 
-    while (object->header() & ~NonLockBitsMask) {
-      if (object->header() & FatMask) {
+    // Spin while the owner is likely to release the lock soon, park once the
+    // budget of the lock is spent.
+    bool parked = false;
+    while (isHeldThin(object->header())) {
+      if (!spinOnThinLock(object, th)) {
+        adaptSpinBudget(object, false);
+        parkOnThinLock(object, th, parkNanos);
+        if (parkNanos < kMaxPark) parkNanos <<= 1;
+        parked = true;
+      }
+    }
+
+    if (!parked && (object->header() & ~NonLockBitsMask) == 0) {
+      // Spinning paid off: keep the lock thin.
+      oldValue = object->header() & NonLockBitsMask;
+      newValue = oldValue | id;
+      yieldedValue = __sync_val_compare_and_swap(&(object->header()), oldValue, newValue);
+      if (yieldedValue == oldValue) {
+        adaptSpinBudget(object, true);
         break;
-      } else {
-        vmkit::Thread::yield();
       }
+      continue;
     }
-    
+
+    // The lock is contended for longer than a spin: inflate it so that the
+    // next threads block on the fat lock.
     if ((object->header() & ~NonLockBitsMask) == 0) {
       FatLock* obj = table.allocate(object);
       obj->internalLock.lock();
@@ -190,14 +419,57 @@ void ThinLock::acquire(gc* object, LockSystem& table) {
       } else {
         assert((object->header() & ~NonLockBitsMask) == obj->getID());
         assert(owner(object, table) && "Inconsistent lock");
+        unparkThinLock(object);
         break;
       }
     }
   }
 
+  if (waitStart != 0) {
+    table.profiler.recordWait(object, th, System::GetNanoTime() - waitStart);
+  }
   assert(owner(object, table) && "Not owner after quitting acquire!");
 }
 
+bool ThinLock::tryAcquire(gc* object, LockSystem& table) {
+  llvm_gcroot(object, 0);
+  uint64_t id = vmkit::Thread::get()->getThreadID();
+
+  if ((object->header() & BiasedMask) && acquireBiased(object, table, id)) {
+    return true;
+  }
+
+  if (owner(object, table)) {
+    // Recursive acquires never block.
+    acquire(object, table);
+    return true;
+  }
+
+  word_t oldValue = 0;
+  word_t newValue = 0;
+  word_t bias = table.isBiasable(object) ? BiasedMask | ThinCountAdd : 0;
+  while ((object->header() & ~NonLockBitsMask) == 0) {
+    oldValue = object->header() & NonLockBitsMask;
+    newValue = oldValue | id | bias;
+    if (__sync_val_compare_and_swap(&(object->header()), oldValue, newValue) ==
+        oldValue) {
+      return true;
+    }
+  }
+
+  if (object->header() & FatMask) {
+    FatLock* obj = table.getFatLockFromID(object->header());
+    if (obj != NULL && obj->tryAcquire() == 0) {
+      if (obj->associatedObject == object) {
+        assert(owner(object, table) && "Not owner after acquiring fat lock!");
+        return true;
+      }
+      obj->internalLock.unlock();
+    }
+  }
+  return false;
+}
+
 /// release - Release the lock.
 void ThinLock::release(gc* object, LockSystem& table, vmkit::Thread* ownerThread) {
   llvm_gcroot(object, 0);
@@ -208,12 +480,32 @@ void ThinLock::release(gc* object, LockSystem& table, vmkit::Thread* ownerThread
   word_t newValue = 0;
   word_t yieldedValue = 0;
 
-  if ((object->header() & ~NonLockBitsMask) == id) {
+  // Only the owner of a bias writes the header.
+  if (ownerThread != vmkit::Thread::get()) revokeBias(object, table, false);
+
+  if (object->header() & BiasedMask) {
+    oldValue = object->header();
+    assert((oldValue & ThinCountMask) && "Releasing a free biased lock");
+    if ((oldValue & ThinCountMask) != ThinCountAdd ||
+        table.isBiasable(object)) {
+      object->header() = oldValue - ThinCountAdd;
+    } else {
+      // Objects of this type are not biased anymore, and other threads wait
+      // for this store instead of revoking the bias.
+      table.profiler.recordRelease(object, ownerThread);
+      __sync_synchronize();
+      object->header() = oldValue & NonLockBitsMask;
+      __sync_synchronize();
+      unparkThinLock(object);
+    }
+  } else if ((object->header() & ~NonLockBitsMask) == id) {
+    table.profiler.recordRelease(object, ownerThread);
     do {
       oldValue = object->header();
       newValue = oldValue & NonLockBitsMask;
       yieldedValue = __sync_val_compare_and_swap(&object->header(), oldValue, newValue);
     } while ((object->header() & ~NonLockBitsMask) == id);
+    unparkThinLock(object);
   } else if (object->header() & FatMask) {
     FatLock* obj = table.getFatLockFromID(object->header());
     assert(obj && "Lock deallocated while held.");
@@ -237,6 +529,10 @@ bool ThinLock::owner(gc* object, LockSystem& table) {
   if (object->header() & FatMask) {
     FatLock* obj = table.getFatLockFromID(object->header());
     if (obj != NULL) return obj->owner();
+  } else if (object->header() & BiasedMask) {
+    word_t header = object->header();
+    return getBiasOwner(header) == vmkit::Thread::get()->getThreadID() &&
+           (header & ThinCountMask) != 0;
   } else {
   	bool res = false;
     uint64 id = vmkit::Thread::get()->getThreadID();
@@ -252,6 +548,10 @@ vmkit::Thread* ThinLock::getOwner(gc* object, LockSystem& table)
   if (object->header() & FatMask) {
 	FatLock* obj = table.getFatLockFromID(object->header());
 	return (!obj) ? NULL : obj->getOwner();
+  } else if (object->header() & BiasedMask) {
+    word_t header = object->header();
+    if (!(header & ThinCountMask)) return NULL;
+    return vmkit::Thread::getByID(getBiasOwner(header));
   } else {
 	uint64_t threadID = object->header() & System::GetThreadIDMask();
 	return vmkit::Thread::getByID(threadID);
@@ -286,10 +586,12 @@ FatLock::FatLock(uint32_t i, gc* a) :
 	associatedObjectDead(false)
 {
   llvm_gcroot(a, 0);
-  assert(a != NULL);
   firstThread = NULL;
+  firstEntry = NULL;
+  lastEntry = NULL;
   index = i;
-  setAssociatedObject(a);
+  associatedObject = NULL;
+  if (a != NULL) setAssociatedObject(a);
   waitingThreads = 0;
   lockingThreads = 0;
   nextFreeLock = NULL;
@@ -303,16 +605,70 @@ void FatLock::release(gc* obj, LockSystem& table, vmkit::Thread* ownerThread) {
   llvm_gcroot(obj, 0);
   assert(associatedObject && "No associated object when releasing");
   assert(associatedObject == obj && "Mismatch object in lock");
-#if 0
-  // Disable fat lock deflation code in ObjectLocks.cpp
-  // Fixes occasional assertion failure when running on multi-core machine.
-  if (!waitingThreads && !lockingThreads &&
-      internalLock.recursionCount() == 1) {
-    vmkit::ThinLock::removeFatLock(this, table);
-    table.deallocate(this);
+  if (lockingThreads) table.profiler.recordRelease(obj, ownerThread);
+  releaseMonitor(false, ownerThread);
+}
+
+void FatLock::pushEntry(LockingThread* th) {
+  th->nextEntry = NULL;
+  if (lastEntry != NULL) {
+    lastEntry->nextEntry = th;
+  } else {
+    firstEntry = th;
+  }
+  lastEntry = th;
+}
+
+LockingThread* FatLock::popEntry() {
+  LockingThread* th = firstEntry;
+  if (th != NULL) {
+    firstEntry = th->nextEntry;
+    if (firstEntry == NULL) lastEntry = NULL;
+    th->nextEntry = NULL;
+  }
+  return th;
+}
+
+bool FatLock::removeEntry(LockingThread* th) {
+  LockingThread* prev = NULL;
+  for (LockingThread* cur = firstEntry; cur != NULL; cur = cur->nextEntry) {
+    if (cur == th) {
+      if (prev != NULL) {
+        prev->nextEntry = cur->nextEntry;
+      } else {
+        firstEntry = cur->nextEntry;
+      }
+      if (lastEntry == cur) lastEntry = prev;
+      cur->nextEntry = NULL;
+      return true;
+    }
+    prev = cur;
+  }
+  return false;
+}
+
+void FatLock::grant(LockingThread* th) {
+  // Once the state is granted the thread may leave the wait: wake its word
+  // after that only, and it handles spurious wake ups.
+  int32_t old = __sync_lock_test_and_set(&th->waitState,
+                                         LockingThread::WaitGranted);
+  if (old == LockingThread::WaitSleeping) {
+    System::FutexWake(&th->waitState, 1);
+  }
+}
+
+int FatLock::releaseMonitor(bool all, vmkit::Thread* ownerThread) {
+  LockingThread* entry = NULL;
+  if (all || internalLock.recursionCount() == 1) entry = popEntry();
+  int count = 1;
+  if (all) {
+    count = internalLock.unlockAll(ownerThread);
+  } else {
+    internalLock.unlock(ownerThread);
   }
-#endif
-  internalLock.unlock(ownerThread);
+  // Wake the thread with the monitor free, so that it does not block again.
+  if (entry != NULL) grant(entry);
+  return count;
 }
 
 /// acquire - Acquires the internalLock.
@@ -353,10 +709,17 @@ bool FatLock::acquire(gc* obj, LockSystem& table) {
 
 void LockSystem::deallocate(FatLock* lock) {
   lock->associatedObject = NULL;
-  threadLock.lock();
-  lock->nextFreeLock = freeLock;
-  freeLock = lock;
-  threadLock.unlock();
+  Shard& shard = shards[lock->index & (NbShards - 1)];
+  shard.lock.lock();
+  lock->nextFreeLock = shard.freeLock;
+  shard.freeLock = lock;
+  shard.lock.unlock();
+}
+
+void LockSystem::flushCache(LockingThread* th) {
+  while (th->nbCachedLocks != 0) {
+    deallocate(th->cachedLocks[--th->nbCachedLocks]);
+  }
 }
   
 LockSystem::LockSystem(vmkit::BumpPtrAllocator& all) : allocator(all) {
@@ -366,48 +729,293 @@ LockSystem::LockSystem(vmkit::BumpPtrAllocator& all) : allocator(all) {
   LockTable[0] = (FatLock**)
     allocator.Allocate(IndexSize * sizeof(FatLock*), "Index LockTable");
   currentIndex = 0;
-  freeLock = NULL;
+  for (uint32_t i = 0; i < NbShards; ++i) shards[i].freeLock = NULL;
+  for (uint32_t i = 0; i < BiasSlots; ++i) {
+    biasStats[i].state = Biasable;
+    biasStats[i].revocations = 0;
+    biasStats[i].lastRevocation = 0;
+  }
 }
 
-FatLock* LockSystem::allocate(gc* obj) {  
-  llvm_gcroot(obj, 0); 
-  FatLock* res = 0;
-  threadLock.lock();
-
-  // Try the freeLock list.
-  if (freeLock != NULL) {
-    res = freeLock;
-    freeLock = res->nextFreeLock;
-    res->nextFreeLock = 0;
-    assert(res->associatedObject == NULL);
-    threadLock.unlock();
-    res->setAssociatedObject(obj);
-  } else { 
-    // Get an index.
-    uint32_t index = currentIndex++;
-    if (index == MaxLocks) {
-      fprintf(stderr, "Ran out of space for allocating locks");
-      abort();
+static uint32_t getBiasSlot(gc* object) {
+  llvm_gcroot(object, 0);
+  word_t type = (word_t)VirtualTable::getVirtualTable(object);
+  return (uint32_t)((type >> 4) ^ (type >> 12)) & (LockSystem::BiasSlots - 1);
+}
+
+bool LockSystem::isBiasable(gc* object) {
+  llvm_gcroot(object, 0);
+  if (!ThinLock::BiasedLocking) return false;
+  return biasStats[getBiasSlot(object)].state != Revoked;
+}
+
+LockProfiler::LockProfiler() {
+  memset(releaseSlots, 0, sizeof(releaseSlots));
+  output = NULL;
+  sampleRate = kDefaultSampleRate;
+  contentions = 0;
+  lostEvents = 0;
+  sites = NULL;
+}
+
+bool LockProfiler::open(const char* name) {
+  FILE* file = fopen(name, "w");
+  if (file == NULL) return false;
+  sites = new Site[kSites];
+  memset(sites, 0, kSites * sizeof(Site));
+  // Sites must be ready before acquisitions are sampled.
+  __sync_synchronize();
+  output = file;
+  return true;
+}
+
+LockProfiler::ReleaseSlot& LockProfiler::getReleaseSlot(gc* object) {
+  llvm_gcroot(object, 0);
+  word_t addr = (word_t)object;
+  return releaseSlots[((addr >> 4) ^ (addr >> 12)) & (kReleaseSlots - 1)];
+}
+
+/// topJavaFrame - The frame of the last Java method the current thread
+/// called, or NULL if there is none.
+static FrameInfo* topJavaFrame(vmkit::Thread* self, word_t& ip) {
+  StackWalker Walker(self);
+  while (FrameInfo* FI = Walker.get()) {
+    if (FI->Metadata != NULL) {
+      ip = Walker.ip;
+      return FI;
     }
-  
-    FatLock** &tab = LockTable[index >> BitIndex];
-  
-    VirtualMachine* vm = vmkit::Thread::get()->MyVM;
+    ++Walker;
+  }
+  ip = 0;
+  return NULL;
+}
+
+void LockProfiler::startWait(gc* object) {
+  llvm_gcroot(object, 0);
+  ReleaseSlot& slot = getReleaseSlot(object);
+  slot.frame = NULL;
+  slot.requested = 1;
+}
+
+void LockProfiler::recordHolder(gc* object, vmkit::Thread* owner) {
+  llvm_gcroot(object, 0);
+  ReleaseSlot& slot = getReleaseSlot(object);
+  if (!slot.requested) return;
+  slot.requested = 0;
+  // Only the current thread can walk its stack.
+  if (owner != vmkit::Thread::get()) return;
+  word_t ip = 0;
+  FrameInfo* frame = topJavaFrame(owner, ip);
+  slot.ip = ip;
+  slot.frame = frame;
+}
+
+LockProfiler::Site* LockProfiler::lookup(FrameInfo* frame) {
+  word_t key = (word_t)frame;
+  uint32_t index = (uint32_t)((key >> 3) ^ (key >> 13)) & (kSites - 1);
+  for (uint32_t i = 0; i < kSites; ++i) {
+    Site* site = &sites[(index + i) & (kSites - 1)];
+    if (site->events == 0 || site->frame == frame) return site;
+  }
+  return NULL;
+}
+
+void LockProfiler::recordWait(gc* object, vmkit::Thread* self,
+                              uint64_t wait) {
+  llvm_gcroot(object, 0);
+  ReleaseSlot& slot = getReleaseSlot(object);
+  FrameInfo* holder = slot.frame;
+  word_t holderIP = slot.ip;
+  slot.requested = 0;
+  if (wait < kMinWait) return;
+
+  word_t ip = 0;
+  FrameInfo* frame = topJavaFrame(self, ip);
+
+  lock.acquire();
+  Site* site = lookup(frame);
+  if (site == NULL) {
+    lostEvents++;
+    lock.release();
+    return;
+  }
+  if (site->events == 0) {
+    site->frame = frame;
+    site->ip = ip;
+    site->typeName = self->MyVM->getObjectTypeName(object);
+  }
+  site->events++;
+  site->totalWait += wait;
+  if (wait > site->maxWait) site->maxWait = wait;
+
+  bool found = false;
+  for (uint32_t i = 0; i < kHolderSites && holder != NULL; ++i) {
+    HolderSite& h = site->holders[i];
+    if (h.events == 0) {
+      h.frame = holder;
+      h.ip = holderIP;
+    }
+    if (h.frame == holder) {
+      h.events++;
+      found = true;
+      break;
+    }
+  }
+  if (!found) site->otherHolders++;
+  lock.release();
+}
+
+static bool longerWait(const LockProfiler::Site* a,
+                       const LockProfiler::Site* b) {
+  return a->totalWait > b->totalWait;
+}
+
+void LockProfiler::dump(VirtualMachine* vm) {
+  if (output == NULL) return;
+  lock.acquire();
+  std::vector<Site*> used;
+  uint64_t events = 0;
+  for (uint32_t i = 0; i < kSites; ++i) {
+    if (sites[i].events != 0) {
+      used.push_back(&sites[i]);
+      events += sites[i].events;
+    }
+  }
+  std::sort(used.begin(), used.end(), longerWait);
+
+  fprintf(output, "lock contention: %llu sampled waits, one contended "
+          "acquisition in %u sampled, %llu waits lost\n",
+          (unsigned long long)events, sampleRate,
+          (unsigned long long)lostEvents);
+  for (std::vector<Site*>::iterator I = used.begin(), E = used.end();
+       I != E; ++I) {
+    Site* site = *I;
+    fprintf(output, "%llu waits on %s, total %llu us, max %llu us, at",
+            (unsigned long long)site->events, site->typeName,
+            (unsigned long long)(site->totalWait / 1000),
+            (unsigned long long)(site->maxWait / 1000));
+    if (site->frame == NULL) {
+      fprintf(output, " an unknown site\n");
+    } else {
+      fprintf(output, "\n");
+      vm->printMethod(site->frame, site->ip, 0, output);
+    }
+    for (uint32_t i = 0; i < kHolderSites; ++i) {
+      HolderSite& h = site->holders[i];
+      if (h.events == 0) break;
+      fprintf(output, "  %llu released by owner at\n",
+              (unsigned long long)h.events);
+      vm->printMethod(h.frame, h.ip, 0, output);
+    }
+    if (site->otherHolders) {
+      fprintf(output, "  %llu released at other or unknown sites\n",
+              (unsigned long long)site->otherHolders);
+    }
+  }
+  fflush(output);
+  lock.release();
+}
+
+bool LockSystem::recordRevocation(gc* object) {
+  llvm_gcroot(object, 0);
+  BiasStats& stats = biasStats[getBiasSlot(object)];
+  uint64_t now = System::GetNanoTime();
+  if (now - stats.lastRevocation > BiasDecayTime) {
+    stats.state = Biasable;
+    stats.revocations = 0;
+  }
+  stats.lastRevocation = now;
+  ++stats.revocations;
+
+  if (stats.revocations >= BulkRevokeThreshold) {
+    stats.state = Revoked;
+  } else if (stats.revocations >= BulkRebiasThreshold) {
+    stats.state = Rebias;
+  }
+  return stats.state == Rebias;
+}
+
+uint32_t LockSystem::takeFreeLocks(uint32_t shard, FatLock** buffer,
+                                   uint32_t count) {
+  Shard& from = shards[shard];
+  // Do not take the spin lock of a shard that looks empty.
+  if (from.freeLock == NULL) return 0;
+  uint32_t taken = 0;
+  from.lock.lock();
+  while (taken < count && from.freeLock != NULL) {
+    FatLock* res = from.freeLock;
+    from.freeLock = res->nextFreeLock;
+    res->nextFreeLock = NULL;
+    assert(res->associatedObject == NULL);
+    buffer[taken++] = res;
+  }
+  from.lock.unlock();
+  return taken;
+}
+
+FatLock* LockSystem::newLock() {
+  // Get an index.
+  uint32_t index = __sync_fetch_and_add(&currentIndex, 1);
+  if (index >= MaxLocks) {
+    fprintf(stderr, "Ran out of space for allocating locks");
+    abort();
+  }
+
+  FatLock** &tab = LockTable[index >> BitIndex];
+  if (tab == NULL) {
+    threadLock.lock();
     if (tab == NULL) {
-      tab = (FatLock**)vm->allocator.Allocate(
+      FatLock** newTab = (FatLock**)allocator.Allocate(
           IndexSize * sizeof(FatLock*), "Index LockTable");
+      __sync_synchronize();
+      tab = newTab;
     }
     threadLock.unlock();
-   
-    // Allocate the lock.
-    res = new(vm->allocator, "Lock") FatLock(index, obj);
-    
-    // Add the lock to the table.
-    uint32_t internalIndex = index & BitMask;
-    tab[internalIndex] = res;
   }
-   
-  assert(res->associatedObject == obj);
+
+  // Allocate the lock.
+  FatLock* res = new(allocator, "Lock") FatLock(index, NULL);
+
+  // Add the lock to the table.
+  uint32_t internalIndex = index & BitMask;
+  __sync_synchronize();
+  tab[internalIndex] = res;
+  return res;
+}
+
+FatLock* LockSystem::allocate(gc* obj) {  
+  llvm_gcroot(obj, 0); 
+  FatLock* res = NULL;
+  vmkit::Thread* self = vmkit::Thread::get();
+  LockingThread* th = self->getLockingThread();
+
+  if (th != NULL && th->nbCachedLocks != 0) {
+    res = th->cachedLocks[--th->nbCachedLocks];
+  } else {
+    FatLock* buffer[LockingThread::CachedLocks + 1];
+    uint32_t wanted = th != NULL ? LockingThread::CachedLocks + 1 : 1;
+    uint32_t home =
+      (uint32_t)(self->getThreadID() / System::GetThreadSlotSize());
+    uint32_t found = 0;
+    // Try the shard of the thread first, then the others.
+    for (uint32_t i = 0; i < NbShards && found == 0; ++i) {
+      found = takeFreeLocks((home + i) & (NbShards - 1), buffer, wanted);
+    }
+    if (found == 0) {
+      while (found < wanted) buffer[found++] = newLock();
+    }
+    res = buffer[--found];
+    if (th != NULL) {
+      assert(found <= LockingThread::CachedLocks);
+      while (found != 0) th->cachedLocks[th->nbCachedLocks++] = buffer[--found];
+    } else {
+      assert(found == 0);
+    }
+  }
+
+  assert(res->associatedObject == NULL);
+  res->associatedObjectDead = false;
+  res->setAssociatedObject(obj);
   // Return the lock.
   return res;
 }
@@ -423,6 +1031,71 @@ FatLock* LockSystem::getFatLockFromID(word_t ID) {
   }
 }
 
+void LockSystem::deflateIdleLocks() {
+  gc* object = NULL;
+  llvm_gcroot(object, 0);
+  // Threads that read the ID of a lock before it is deflated find out in
+  // FatLock::acquire that the lock moved to another object, and start over.
+  for (uint32_t index = 0; index < currentIndex; ++index) {
+    FatLock* lock = LockTable[index >> BitIndex] ?
+        getLock(index) : NULL;
+    if (lock == NULL) continue;
+    object = lock->associatedObject;
+    if (object == NULL || !lock->isIdle()) continue;
+    // A lock being installed is not in the header of its object yet, and
+    // the installing thread holds on to it.
+    if ((object->header() & ~ThinLock::NonLockBitsMask) != lock->getID()) {
+      continue;
+    }
+    ThinLock::removeFatLock(lock, *this);
+    deallocate(lock);
+  }
+
+  // Objects of revoked types are not biased, so their types may see no more
+  // revocations: decay their counts here.
+  uint64_t now = System::GetNanoTime();
+  for (uint32_t i = 0; i < BiasSlots; ++i) {
+    BiasStats& stats = biasStats[i];
+    if (stats.state == Revoked &&
+        now - stats.lastRevocation > BiasDecayTime) {
+      stats.state = Biasable;
+      stats.revocations = 0;
+    }
+  }
+}
+
+void LockSystem::scanLocks(word_t closure) {
+  gc* object = NULL;
+  llvm_gcroot(object, 0);
+  for (uint32_t index = 0; index < currentIndex; ++index) {
+    FatLock* lock = LockTable[index >> BitIndex] ?
+        getLock(index) : NULL;
+    if (lock == NULL) continue;
+    object = lock->associatedObject;
+    if (object == NULL) {
+      // The object of the lock died while threads still used the lock: free
+      // it once they are done.
+      if (lock->associatedObjectDead && lock->isIdle()) {
+        lock->associatedObjectDead = false;
+        deallocate(lock);
+      }
+      continue;
+    }
+    if (vmkit::Collector::isLive(object, closure)) {
+      lock->associatedObject =
+          vmkit::Collector::getForwardedReferent(object, closure);
+    } else if (lock->isIdle()) {
+      deallocate(lock);
+    } else {
+      // Threads hold the objects they lock, so this should not happen. Let
+      // them fail in FatLock::acquire rather than keep a dangling pointer,
+      // and free the lock on a later scan.
+      lock->markAssociatedObjectAsDead();
+      lock->associatedObject = NULL;
+    }
+  }
+}
+
 
 
 bool LockingThread::wait(
@@ -432,7 +1105,6 @@ bool LockingThread::wait(
 
   FatLock* l = vmkit::ThinLock::changeToFatlock(self, table);
   this->waitsOn = l;
-  vmkit::Cond& varcondThread = this->varcond;
 
   if (this->interruptFlag != 0) {
     this->interruptFlag = 0;
@@ -464,17 +1136,39 @@ bool LockingThread::wait(
          "Inconsistent list");
       
   bool timeout = false;
+  uint64_t deadline = 0;
+  if (timed) {
+    deadline = System::GetNanoTime() + info->tv_sec * 1000000000ULL +
+               info->tv_usec * 1000ULL;
+  }
 
   l->waitingThreads++;
 
-  while (!this->interruptFlag && this->nextWaiting) {
+  // Publish the state before reading the interrupt flag: interrupters set
+  // the flag before they change the state.
+  this->waitState = WaitSleeping;
+  __sync_synchronize();
+  vmkit::Thread* th = vmkit::Thread::get();
+  int count = l->releaseMonitor(true, th);
+
+  while (this->waitState == WaitSleeping && !this->interruptFlag) {
+    struct timespec timeout_ts;
     if (timed) {
-      timeout = varcondThread.timedWait(&l->internalLock, info);
-      if (timeout) break;
-    } else {
-      varcondThread.wait(&l->internalLock);
+      uint64_t now = System::GetNanoTime();
+      if (now >= deadline) {
+        timeout = true;
+        break;
+      }
+      timeout_ts.tv_sec = (deadline - now) / 1000000000ULL;
+      timeout_ts.tv_nsec = (deadline - now) % 1000000000ULL;
     }
+    th->enterUncooperativeCode();
+    System::FutexWait(&this->waitState, WaitSleeping,
+                      timed ? &timeout_ts : NULL);
+    th->leaveUncooperativeCode();
   }
+
+  l->internalLock.lockAll(count);
   assert(vmkit::ThinLock::owner(self, table) && "Not owner after wait");
       
   l->waitingThreads--;
@@ -505,6 +1199,11 @@ bool LockingThread::wait(
       this->prevWaiting = NULL;
     } else {
       assert(!this->prevWaiting && "Inconsistent state");
+      if (!l->removeEntry(this)) {
+        // A release took us off the entry queue and is granting us the
+        // monitor: let it finish with our state.
+        while (this->waitState != WaitGranted) vmkit::Thread::yield();
+      }
       // Notify lost, notify someone else.
       notify(self, table);
     }
@@ -557,7 +1256,7 @@ void LockingThread::notify(gc* self, LockSystem& table, vmkit::Thread* ownerThre
       }
       cur->prevWaiting = NULL;
       cur->nextWaiting = NULL;
-      cur->varcond.signal();
+      l->pushEntry(cur);
       break;
     }
   } while (cur != l->firstThread);
@@ -577,13 +1276,22 @@ void LockingThread::notifyAll(gc* self, LockSystem& table, vmkit::Thread* ownerT
     LockingThread* temp = cur->nextWaiting;
     cur->prevWaiting = NULL;
     cur->nextWaiting = NULL;
-    cur->varcond.signal();
+    l->pushEntry(cur);
     cur = temp;
   } while (cur != l->firstThread);
   l->firstThread = NULL;
   assert((vmkit::ThinLock::getOwner(self, table) == ownerThread) && "Not owner after notifyAll");
 }
 
+void LockingThread::interruptWait() {
+  __sync_synchronize();
+  if (__sync_bool_compare_and_swap(&waitState, WaitSleeping,
+                                   WaitInterrupted)) {
+    state = StateInterrupted;
+    System::FutexWake(&waitState, 1);
+  }
+}
+
 void FatLock::setAssociatedObject(gc* obj) {
   llvm_gcroot(obj, 0);
   vmkit::Collector::objectReferenceNonHeapWriteBarrier((gc**)&associatedObject, (gc*)obj);
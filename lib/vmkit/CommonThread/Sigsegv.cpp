@@ -14,8 +14,10 @@
 #include "vmkit/Thread.h"
 #include "vmkit/Locks.h"
 
+#include <cerrno>
 #include <csignal>
 #include <cstdio>
+#include <unistd.h>
 
 using namespace vmkit;
 
@@ -26,6 +28,7 @@ namespace {
     Handler(void* ucontext): context(ucontext) {}
     void UpdateRegistersForNPE();
     void UpdateRegistersForStackOverflow();
+    void UpdateRegistersForSafepoint();
   };
 }
 
@@ -44,6 +47,10 @@ void Handler::UpdateRegistersForNPE() {
   UNREACHABLE();
 }
 
+void Handler::UpdateRegistersForSafepoint() {
+  UNREACHABLE();
+}
+
 bool System::SupportsHardwareNullCheck() {
   return false;
 }
@@ -51,6 +58,10 @@ bool System::SupportsHardwareNullCheck() {
 bool System::SupportsHardwareStackOverflow() {
   return false;
 }
+
+bool System::SupportsHardwareSafepointPoll() {
+  return false;
+}
 #endif
 
 extern "C" void ThrowStackOverflowError(word_t ip) {
@@ -74,7 +85,11 @@ void sigsegvHandler(int n, siginfo_t *info, void *context) {
   Handler handler(context);
   vmkit::Thread* th = vmkit::Thread::get();
   word_t addr = (word_t)info->si_addr;
-  if (th->IsStackOverflowAddr(addr)) {
+  if (th->isVmkitThread() && th->MyVM->rendezvous.isPollingPageAddr(th, addr)) {
+    // A safe point poll in compiled code: make the thread call
+    // conditionalSafePoint and retry the poll afterwards.
+    handler.UpdateRegistersForSafepoint();
+  } else if (th->IsStackOverflowAddr(addr)) {
     if (vmkit::System::SupportsHardwareStackOverflow()) {
       handler.UpdateRegistersForStackOverflow();
     } else {
@@ -96,13 +111,30 @@ void sigsegvHandler(int n, siginfo_t *info, void *context) {
   }
 }
 
+/// wakeUpForCtrl_C - Wake up the thread that handles Ctrl_C and SIGQUIT.
+/// Called from signal handlers.
+static void wakeUpForCtrl_C() {
+  int savedErrno = errno;
+  char c = 0;
+  if (write(pipeForCtrl_C[1], &c, 1) < 0) {
+    // Nothing to do: the pipe is not created yet, or already full of
+    // wake ups.
+  }
+  errno = savedErrno;
+}
+
 void sigsTermHandler(int n, siginfo_t *info, void *context) {
 	//fprintf(stderr, "\nJVM termination because user request\n");
 	finishForCtrl_C = true;
-	condForCtrl_C.signal();
+	wakeUpForCtrl_C();
 	//lockForCtrl_C.Lock();
 	//lockForCtrl_C.unlock()
 	//Thread::get()->onVMTermination();
 	//UserClass* cl = vm->upcalls->SystemClass;
 	//vm -> upcalls->SystemExit->invokeIntStatic(vm,Class* cl, 0);
 }
+
+void sigQuitHandler(int n, siginfo_t *info, void *context) {
+	dumpForSigQuit = true;
+	wakeUpForCtrl_C();
+}
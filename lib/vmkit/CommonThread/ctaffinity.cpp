@@ -0,0 +1,211 @@
+//===------- ctaffinity.cpp - CPU placement of threads by role ------------===//
+//
+//                            The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "vmkit/Thread.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+namespace vmkit {
+
+#if defined(__linux__)
+
+static const char* RoleNames[ThreadAffinity::NbRoles] = {
+  "mutator", "gc", "finalizer", "reference"
+};
+
+/// RoleSets - The CPUs of each role, valid if RoleBound is set.
+static cpu_set_t RoleSets[ThreadAffinity::NbRoles];
+static bool RoleBound[ThreadAffinity::NbRoles];
+
+/// AllCpus - The CPUs the process could use when the options were parsed.
+static cpu_set_t AllCpus;
+
+/// Configured - If any option was given. Otherwise threads are never moved.
+static bool Configured = false;
+
+static ThreadAffinity::Placement MutatorPlacement = ThreadAffinity::Float;
+
+/// MutatorCpus - The CPUs mutators are pinned to, in placement order.
+static int MutatorCpus[CPU_SETSIZE];
+static uint32_t NbMutatorCpus = 0;
+static volatile uint32_t NextMutator = 0;
+
+/// CollectorSaved - The CPUs of the current collection initiator before it
+/// moved to the collector CPUs. There is only one initiator at a time.
+static cpu_set_t CollectorSaved;
+static bool CollectorMoved = false;
+
+/// parseCpus - Add a CPU or a range of CPUs, as in "4" or "0-3", to set.
+static bool parseCpus(const char* cur, const char* end, cpu_set_t* set) {
+  char* next = NULL;
+  long first = strtol(cur, &next, 10);
+  if (next == cur || first < 0) return false;
+  long last = first;
+  if (next < end && *next == '-') {
+    cur = next + 1;
+    last = strtol(cur, &next, 10);
+    if (next == cur || last < first) return false;
+  }
+  if (next != end || last >= CPU_SETSIZE) return false;
+  for (long cpu = first; cpu <= last; ++cpu) CPU_SET(cpu, set);
+  return true;
+}
+
+/// getPackage - The physical package of a CPU, or 0 if unknown.
+static int getPackage(int cpu) {
+  char name[128];
+  snprintf(name, sizeof(name),
+           "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+  FILE* file = fopen(name, "r");
+  if (file == NULL) return 0;
+  int package = 0;
+  if (fscanf(file, "%d", &package) != 1 || package < 0) package = 0;
+  fclose(file);
+  return package;
+}
+
+/// orderMutatorCpus - Compute the CPUs mutators are pinned to: the CPUs of
+/// the process no other role uses, in placement order.
+static void orderMutatorCpus() {
+  int cpus[CPU_SETSIZE];
+  int packages[CPU_SETSIZE];
+  uint32_t nbCpus = 0;
+  int maxPackage = 0;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (!CPU_ISSET(cpu, &AllCpus)) continue;
+    bool reserved = false;
+    for (uint32_t role = ThreadAffinity::Collector;
+         role < ThreadAffinity::NbRoles; ++role) {
+      if (RoleBound[role] && CPU_ISSET(cpu, &RoleSets[role])) reserved = true;
+    }
+    if (reserved) continue;
+    cpus[nbCpus] = cpu;
+    packages[nbCpus] = getPackage(cpu);
+    if (packages[nbCpus] > maxPackage) maxPackage = packages[nbCpus];
+    ++nbCpus;
+  }
+
+  NbMutatorCpus = 0;
+  if (MutatorPlacement == ThreadAffinity::Compact) {
+    for (int package = 0; package <= maxPackage; ++package) {
+      for (uint32_t i = 0; i < nbCpus; ++i) {
+        if (packages[i] == package) MutatorCpus[NbMutatorCpus++] = cpus[i];
+      }
+    }
+  } else {
+    // Take the first CPU of each package, then the second, and so on.
+    bool taken[CPU_SETSIZE];
+    memset(taken, 0, sizeof(taken));
+    while (NbMutatorCpus < nbCpus) {
+      for (int package = 0; package <= maxPackage; ++package) {
+        for (uint32_t i = 0; i < nbCpus; ++i) {
+          if (!taken[i] && packages[i] == package) {
+            taken[i] = true;
+            MutatorCpus[NbMutatorCpus++] = cpus[i];
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+bool ThreadAffinity::parse(const char* options) {
+  if (sched_getaffinity(0, sizeof(AllCpus), &AllCpus) != 0) return false;
+
+  int role = -1;
+  const char* cur = options;
+  while (*cur != 0) {
+    const char* end = strchr(cur, ',');
+    if (end == NULL) end = cur + strlen(cur);
+    const char* equal = (const char*)memchr(cur, '=', end - cur);
+    if (equal != NULL) {
+      role = -1;
+      for (uint32_t i = 0; i < NbRoles; ++i) {
+        if (strlen(RoleNames[i]) == (size_t)(equal - cur) &&
+            !strncmp(cur, RoleNames[i], equal - cur)) {
+          role = i;
+        }
+      }
+      if (role < 0) return false;
+      cur = equal + 1;
+      if (role == Mutator && end - cur == 7 && !strncmp(cur, "compact", 7)) {
+        MutatorPlacement = Compact;
+        role = -1;
+      } else if (role == Mutator && end - cur == 7 &&
+                 !strncmp(cur, "scatter", 7)) {
+        MutatorPlacement = Scatter;
+        role = -1;
+      } else {
+        CPU_ZERO(&RoleSets[role]);
+        RoleBound[role] = true;
+      }
+    }
+    // CPUs without a role name belong to the previous role, as in
+    // "gc=0-3,8,finalizer=4".
+    if (role >= 0 && !parseCpus(cur, end, &RoleSets[role])) return false;
+    if (role < 0 && equal == NULL) return false;
+    cur = *end ? end + 1 : end;
+  }
+
+  Configured = true;
+  if (MutatorPlacement != Float) orderMutatorCpus();
+  return true;
+}
+
+void ThreadAffinity::apply(Role role) {
+  if (!Configured) return;
+  cpu_set_t set;
+  if (role == Mutator && NbMutatorCpus != 0) {
+    uint32_t index = __sync_fetch_and_add(&NextMutator, 1) % NbMutatorCpus;
+    CPU_ZERO(&set);
+    CPU_SET(MutatorCpus[index], &set);
+  } else if (RoleBound[role]) {
+    set = RoleSets[role];
+  } else {
+    // A recycled thread may have had another role.
+    set = AllCpus;
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+void ThreadAffinity::enterCollector() {
+  if (!Configured || !RoleBound[Collector]) return;
+  CollectorMoved = !pthread_getaffinity_np(pthread_self(),
+                                           sizeof(CollectorSaved),
+                                           &CollectorSaved);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t),
+                         &RoleSets[Collector]);
+}
+
+void ThreadAffinity::leaveCollector() {
+  if (!CollectorMoved) return;
+  CollectorMoved = false;
+  pthread_setaffinity_np(pthread_self(), sizeof(CollectorSaved),
+                         &CollectorSaved);
+}
+
+#else
+
+bool ThreadAffinity::parse(const char* options) {
+  fprintf(stderr, "Thread affinity is not supported on this platform\n");
+  return true;
+}
+
+void ThreadAffinity::apply(Role role) {}
+void ThreadAffinity::enterCollector() {}
+void ThreadAffinity::leaveCollector() {}
+
+#endif
+
+}
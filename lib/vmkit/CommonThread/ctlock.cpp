@@ -23,11 +23,76 @@ namespace vmkit {
 
 /**
  * These variables are used to implement some behavior
- * when the user presses Ctrl_C.
+ * when the user presses Ctrl_C. The signal handlers set a flag and write a
+ * byte to the pipe, which is async-signal-safe, to wake up the thread that
+ * reads it.
  */
-LockNormal lockForCtrl_C;
-Cond condForCtrl_C;
-bool finishForCtrl_C = false;
+volatile bool finishForCtrl_C = false;
+volatile bool dumpForSigQuit = false;
+int pipeForCtrl_C[2] = { -1, -1 };
+
+
+void SpinLock::acquireSlow() {
+  Node node;
+  node.next = NULL;
+  node.state = Waiting;
+  __sync_synchronize();
+  Node* prev = __sync_lock_test_and_set(&tail, &node);
+
+  if (prev != NULL) {
+    prev->next = &node;
+    for (uint32 count = 0; node.state != First; ++count) {
+      if (count < SpinCount) {
+        System::Pause();
+      } else {
+        __sync_val_compare_and_swap(&node.state, Waiting, Sleeping);
+        System::FutexWait(&node.state, Sleeping);
+      }
+    }
+  }
+
+  // We are the first waiter. Threads that are not queued may still take the
+  // lock when it is free, until we ask for a handoff.
+  for (uint32 count = 0; ; ++count) {
+    int32_t value = locked;
+    if (value == 0 || value == Handoff) {
+      if (__sync_bool_compare_and_swap(&locked, value, Held)) break;
+    } else if (count < SpinCount) {
+      System::Pause();
+    } else if (value == Held) {
+      __sync_val_compare_and_swap(&locked, Held, Held | Handoff);
+    } else {
+      System::FutexWait(&locked, Held | Handoff);
+    }
+  }
+
+  // Make the next waiter the first one. Our node goes away with this frame.
+  Node* succ = node.next;
+  if (succ == NULL) {
+    if (__sync_bool_compare_and_swap(&tail, &node, (Node*)NULL)) return;
+    // A new waiter is linking itself after our node. It may be descheduled.
+    for (uint32 count = 0; (succ = node.next) == NULL; ++count) {
+      if (count < SpinCount) {
+        System::Pause();
+      } else {
+        vmkit::Thread::yield();
+      }
+    }
+  }
+  if (__sync_val_compare_and_swap(&succ->state, Waiting, First) != Waiting) {
+    // Only we change the state of a sleeping waiter.
+    succ->state = First;
+    System::FutexWake(&succ->state, 1);
+  }
+}
+
+void SpinLock::releaseSlow() {
+  // The first waiter asked for a handoff and sleeps on the lock word. No
+  // other thread changes the word until it takes the lock.
+  __sync_synchronize();
+  locked = Handoff;
+  System::FutexWake(&locked, 1);
+}
 
 
 Lock::Lock() {
@@ -50,6 +50,15 @@ void Thread::yield(void) {
   sched_yield();
 }
 
+void Thread::handshake(Thread* target, HandshakeClosure* closure) {
+  Thread* self = Thread::get();
+  if (target == self) {
+    closure->doThread(self);
+  } else {
+    self->MyVM->rendezvous.handshake(target, closure);
+  }
+}
+
 void Thread::joinRVBeforeEnter() {
   MyVM->rendezvous.joinBeforeUncooperative(); 
 }
@@ -255,10 +264,6 @@ word_t Thread::waitOnSP() {
 
 word_t Thread::baseAddr = 0;
 
-// These could be set at runtime.
-#define STACK_SIZE 0x100000
-#define NR_THREADS 255
-
 /// StackThreadManager - This class allocates all stacks for threads. Because
 /// we want fast access to thread local data, and can not rely on platform
 /// dependent thread local storage (eg pthread keys are inefficient, tls is
@@ -266,62 +271,240 @@ word_t Thread::baseAddr = 0;
 /// stack. A simple mask computes the thread local data , based on the current
 /// stack pointer.
 //
-/// The stacks are allocated at boot time. They must all be in the memory range
-/// 0x?0000000 and Ox(?+1)0000000, so that the thread local data can be computed
-/// and threads have a unique ID.
+/// The whole thread region is reserved at boot time, so that all stacks are
+/// in the range kThreadStart and kThreadStart + kThreadRegionSize and threads
+/// have a unique ID. Slots are only made accessible in chunks, when all the
+/// slots committed so far are in use.
+///
+/// A slot is laid out as follows: the Thread object in the first page, then
+/// the safe point polling page of the thread, then the alternative signal
+/// stack, then a protected zone, and the execution
+/// stack at the top of the slot. The size of the protected zone depends on
+/// the stack size the slot was last handed out with.
+///
+/// The manager also recycles native threads. When a thread finishes its
+/// routine and fewer than MaxIdleThreads are parked, it keeps its slot and
+/// waits on the slot state instead of exiting. The next allocation takes the
+/// slot of a parked thread, and Thread::start wakes that thread up instead of
+/// creating a new one. Parked threads keep their signal stack and handlers.
+///
+/// Native threads that attach to the VM get a slot too, but keep running on
+/// their own stack. The manager keeps the thread-local key that finds their
+/// Thread object.
 ///
 class StackThreadManager {
 public:
+  static const uint32 MaxThreads = kThreadRegionSize / kThreadSlotSize;
+  static const uint32 SlotsPerChunk = 32;
+  static const uint32 MaxIdleThreads = 32;
+
+  /// Slot states, only used for slots of native threads that may be parked.
+  enum {
+    Running = 0, // The slot is free or its thread runs a routine.
+    Parking,     // The thread finished its routine and will be parked.
+    Idle,        // The thread is parked, the slot can be allocated.
+    Reserved,    // The slot was allocated, the thread is still parked.
+    Starting     // The thread was given a new routine.
+  };
+
+  /// MinStackSize - Stacks can not be smaller than this: the JIT and the
+  /// runtime need some room when called from a thread.
+  static const word_t MinStackSize = 0x40000;
+
   word_t baseAddr;
-  uint32 allocPtr;
-  uint32 used[NR_THREADS];
+  uint32 committedSlots;
+  uint32 nbFree;
+  uint32 freeSlots[MaxThreads];
+  word_t slotStackSize[MaxThreads];
+  word_t stackSize;
   LockNormal stackLock;
 
+  volatile int32_t slotState[MaxThreads];
+  pthread_t slotThread[MaxThreads];
+  uint32 idleSlots[MaxIdleThreads];
+  uint32 nbIdle;
+  uint32 nbParked;
+
+  pthread_key_t attachedKey;
+
   StackThreadManager() {
     baseAddr = 0;
     word_t ptr = kThreadStart;
 
-    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED;
-    baseAddr = (word_t)mmap((void*)ptr, STACK_SIZE * NR_THREADS,
-                               PROT_READ | PROT_WRITE, flags, -1, 0);
+    uint32 flags = MAP_PRIVATE | MAP_ANON | MAP_FIXED | MAP_NORESERVE;
+    baseAddr = (word_t)mmap((void*)ptr, kThreadRegionSize, PROT_NONE, flags,
+                            -1, 0);
 
     if (baseAddr == (word_t) MAP_FAILED) {
       fprintf(stderr, "Can not allocate thread memory\n");
       abort();
     }
- 
-    // Protect the page after the alternative stack.
-    uint32 pagesize = System::GetPageSize();
-    for (uint32 i = 0; i < NR_THREADS; ++i) {
-      word_t addr = baseAddr + (i * STACK_SIZE) + pagesize
-        + vmkit::System::GetAlternativeStackSize();
-      mprotect((void*)addr, pagesize, PROT_NONE);
-    }
 
-    memset((void*)used, 0, NR_THREADS * sizeof(uint32));
-    allocPtr = 0;
+    memset((void*)slotStackSize, 0, MaxThreads * sizeof(word_t));
+    memset((void*)slotState, 0, MaxThreads * sizeof(int32_t));
+    committedSlots = 0;
+    nbFree = 0;
+    nbIdle = 0;
+    nbParked = 0;
+    stackSize = getMaxStackSize();
+    pthread_key_create(&attachedKey, NULL);
     vmkit::Thread::baseAddr = baseAddr;
   }
 
-  word_t allocate() {
-    stackLock.lock();
-    uint32 myIndex = 0;
-    do {
-      if (!used[myIndex]) {
-        used[myIndex] = 1;
+  static word_t getHeaderSize() {
+    return 2 * System::GetPageSize() + System::GetAlternativeStackSize();
+  }
+
+  /// getMaxStackSize - The biggest stack that still leaves a protected page
+  /// between the alternative stack and the execution stack.
+  static word_t getMaxStackSize() {
+    return kThreadSlotSize - getHeaderSize() - System::GetPageSize();
+  }
+
+  word_t setStackSize(word_t size) {
+    size = System::PageAlignUp(size);
+    if (size < MinStackSize) size = MinStackSize;
+    if (size > getMaxStackSize()) size = getMaxStackSize();
+    stackSize = size;
+    return size;
+  }
+
+  /// commitChunk - Make the header pages of the next chunk of slots
+  /// accessible and put them in the free list. Called with stackLock held.
+  bool commitChunk() {
+    if (committedSlots == MaxThreads) return false;
+    uint32 first = committedSlots;
+    uint32 last = first + SlotsPerChunk;
+    if (last > MaxThreads) last = MaxThreads;
+
+    for (uint32 i = first; i < last; ++i) {
+      word_t addr = baseAddr + i * kThreadSlotSize;
+      if (mprotect((void*)addr, getHeaderSize(), PROT_READ | PROT_WRITE)) {
+        last = i;
         break;
       }
-      ++myIndex;
-    } while (myIndex != NR_THREADS);
-  
+    }
+    if (last == first) return false;
+
+    // Push in reverse order, so that lower slots are handed out first.
+    for (uint32 i = last; i != first; --i) {
+      freeSlots[nbFree++] = i - 1;
+    }
+    committedSlots = last;
+    return true;
+  }
+
+  /// prepareStack - Make the top size bytes of the slot accessible, and
+  /// protect the rest. Stacks that shrink give their pages back.
+  void prepareStack(uint32 index, word_t size) {
+    word_t old = slotStackSize[index];
+    if (old == size) return;
+    word_t top = baseAddr + (index + 1) * kThreadSlotSize;
+    if (old > size) {
+      madvise((void*)(top - old), old - size, MADV_DONTNEED);
+      mprotect((void*)(top - old), old - size, PROT_NONE);
+    } else {
+      mprotect((void*)(top - size), size, PROT_READ | PROT_WRITE);
+    }
+    slotStackSize[index] = size;
+  }
+
+  uint32 getIndex(word_t addr) {
+    return (addr - baseAddr) / kThreadSlotSize;
+  }
+
+  /// allocate - Get a slot. Only threads that Thread::start runs may get
+  /// the slot of a parked thread: the parked thread runs them.
+  word_t allocate(bool mayBeParked) {
+    stackLock.lock();
+    uint32 myIndex = 0;
+    if (mayBeParked && nbIdle != 0) {
+      myIndex = idleSlots[--nbIdle];
+      slotState[myIndex] = Reserved;
+    } else if (nbFree != 0 || commitChunk()) {
+      myIndex = freeSlots[--nbFree];
+    } else {
+      stackLock.unlock();
+      return 0;
+    }
+    // A parked thread only uses the top of its stack, shrinking it is fine.
+    prepareStack(myIndex, stackSize);
     stackLock.unlock();
-    
-    if (myIndex != NR_THREADS)
-      return baseAddr + myIndex * STACK_SIZE;
+    return baseAddr + myIndex * kThreadSlotSize;
+  }
 
-    return 0;
+  /// release - Give the slot of a dead thread back, or make the slot of a
+  /// parked thread allocatable. A slot allocated from a parked thread but
+  /// never started still has the parked thread waiting on it.
+  void release(word_t addr) {
+    uint32 index = getIndex(addr);
+    stackLock.lock();
+    if (slotState[index] == Parking || slotState[index] == Reserved) {
+      slotState[index] = Idle;
+      idleSlots[nbIdle++] = index;
+    } else {
+      slotState[index] = Running;
+      freeSlots[nbFree++] = index;
+    }
+    stackLock.unlock();
+  }
+
+  /// isParking - If the thread of the slot left the VM to be parked.
+  bool isParking(word_t addr) {
+    return slotState[getIndex(addr)] == Parking;
   }
 
+  /// isParked - If the slot was allocated from a parked thread.
+  bool isParked(word_t addr) {
+    return slotState[getIndex(addr)] == Reserved;
+  }
+
+  /// park - Called by a thread that finished its routine, before it leaves
+  /// the VM. Returns true if the thread must wait for a new routine rather
+  /// than exit.
+  bool park(word_t addr) {
+    uint32 index = getIndex(addr);
+    bool res = false;
+    stackLock.lock();
+    if (nbParked < MaxIdleThreads) {
+      nbParked++;
+      slotThread[index] = pthread_self();
+      slotState[index] = Parking;
+      res = true;
+    }
+    stackLock.unlock();
+    return res;
+  }
+
+  /// waitForRoutine - Wait in a parked thread until Thread::start hands it
+  /// a new routine.
+  void waitForRoutine(word_t addr) {
+    uint32 index = getIndex(addr);
+    int32_t state = slotState[index];
+    while (state != Starting) {
+      System::FutexWait(&(slotState[index]), state);
+      state = slotState[index];
+    }
+    slotState[index] = Running;
+  }
+
+  /// unpark - Hand a new routine to the parked thread of the slot. Returns
+  /// the native thread.
+  pthread_t unpark(word_t addr) {
+    uint32 index = getIndex(addr);
+    stackLock.lock();
+    nbParked--;
+    stackLock.unlock();
+    __sync_synchronize();
+    slotState[index] = Starting;
+    System::FutexWake(&(slotState[index]), 1);
+    return slotThread[index];
+  }
+
+  word_t getStackBottom(word_t addr) {
+    uint32 index = (addr - baseAddr) / kThreadSlotSize;
+    return addr + kThreadSlotSize - slotStackSize[index];
+  }
 };
 
 
@@ -329,16 +512,32 @@ public:
 /// machine specific.
 StackThreadManager TheStackManager;
 
+word_t Thread::setDefaultStackSize(word_t size) {
+  return TheStackManager.setStackSize(size);
+}
+
+word_t Thread::getDefaultStackSize() {
+  return TheStackManager.stackSize;
+}
+
+word_t Thread::GetStackBottom() {
+  // The signal handlers may ask for threads that VMKit did not create.
+  if (!isVmkitThread()) {
+    return GetAlternativeStackStart() + System::GetPageSize();
+  }
+  return TheStackManager.getStackBottom((word_t)this);
+}
+
 extern void sigsegvHandler(int, siginfo_t*, void*);
 extern void sigsTermHandler(int n, siginfo_t *info, void *context);
+extern void sigQuitHandler(int n, siginfo_t *info, void *context);
 
 /// internalThreadStart - The initial function called by a thread. Sets some
 /// thread specific data, registers the thread to the GC and calls the
-/// given routine of th.
+/// given routine of th. When the routine returns, the thread may be parked
+/// and run the routine of a new Thread object, allocated in the same slot.
 ///
 void Thread::internalThreadStart(vmkit::Thread* th) {
-  th->baseSP  = System::GetCallerAddress();
-
   // Set the alternate stack as the second page of the thread's
   // stack.
   stack_t st;
@@ -368,25 +567,45 @@ void Thread::internalThreadStart(vmkit::Thread* th) {
   sigaction(SIGHUP, &sa, NULL);
   sigaction(SIGINT, &sa, NULL);
   //sigaction(SIGTERM, &sa, NULL);
-
-  assert(th->MyVM && "VM not set in a thread");
+  // to dump the lock profile
+  sa.sa_sigaction = sigQuitHandler;
+  sigaction(SIGQUIT, &sa, NULL);
+
+  word_t addr = (word_t)th;
+  bool parked = false;
+  do {
+    // th is the same on every iteration, but is a new Thread object after the
+    // thread has been parked.
+    th = (vmkit::Thread*)addr;
+    th->baseSP = System::GetCallerAddress();
+    ThreadAffinity::apply(th->getAffinityRole());
+    assert(th->MyVM && "VM not set in a thread");
 //  fprintf(stderr, "Thread %p has TID %ld\n", th,syscall(SYS_gettid) );
-  th->MyVM->rendezvous.addThread(th);
-  th->routine(th);
-  th->MyVM->removeThread(th);
+    th->MyVM->rendezvous.addThread(th);
+    th->routine(th);
+    th->MyVM->rendezvous.logThreadHistogram(th);
+    parked = TheStackManager.park(addr);
+    th->MyVM->removeThread(th);
+    // From now on, the slot may be allocated again: do not use th.
+    if (parked) TheStackManager.waitForRoutine(addr);
+  } while (parked);
 }
 
 
 
 /// start - Called by the creator of the thread to run the new thread.
 int Thread::start(void (*fct)(vmkit::Thread*)) {
-  pthread_attr_t attributs;
-  pthread_attr_init(&attributs);
-  pthread_attr_setstack(&attributs, this, STACK_SIZE);
   routine = fct;
   // Make sure to add it in the list of threads before leaving this function:
   // the garbage collector wants to trace this thread.
   MyVM->addThread(this);
+  if (TheStackManager.isParked((word_t)this)) {
+    internalThreadID = (void*)TheStackManager.unpark((word_t)this);
+    return 0;
+  }
+  pthread_attr_t attributs;
+  pthread_attr_init(&attributs);
+  pthread_attr_setstack(&attributs, this, kThreadSlotSize);
   int res = pthread_create((pthread_t*)(void*)(&internalThreadID), &attributs,
                            (void* (*)(void *))internalThreadStart, this);
   pthread_attr_destroy(&attributs);
@@ -397,12 +616,15 @@ int Thread::start(void (*fct)(vmkit::Thread*)) {
 /// operator new - Get a stack from the stack manager. The Thread object
 /// will be placed in the first page at the bottom of the stack. Hence
 /// Thread objects can not exceed a page.
-void* Thread::operator new(size_t sz) {
+void* Thread::operator new(size_t sz, SlotUse use) {
   assert(sz < (size_t)getpagesize() && "Thread local data too big");
-  void* res = (void*)TheStackManager.allocate();
+  void* res = (void*)TheStackManager.allocate(use == StartedSlot);
+  if (res == NULL) {
+    fprintf(stderr, "Ran out of space for allocating threads\n");
+    abort();
+  }
   // Make sure the thread information is cleared.
-  if (res != NULL) memset(res, 0, sz);
-  assert(res && "Thread cannot be allocated because there is no room available");
+  memset(res, 0, sz);
   return res;
 }
 
@@ -413,13 +635,171 @@ void Thread::releaseThread(vmkit::Thread* th) {
   // the stack of the thread. So we have to get the thread id before
   // calling pthread_join.
   void* thread_id = th->internalThreadID;
-  if (thread_id != NULL) {
+  word_t addr = (word_t)th & System::GetThreadIDMask();
+  // Parked threads do not die.
+  if (thread_id != NULL && !TheStackManager.isParking(addr)) {
     // Wait for the thread to die.
     pthread_join((pthread_t)thread_id, NULL);
   }
-  word_t index = ((word_t)th & System::GetThreadIDMask());
-  index = (index & ~TheStackManager.baseAddr) >> 20;
-  TheStackManager.used[index] = 0;
+  TheStackManager.release(addr);
+}
+
+#if defined(ARCH_X64) || defined(ARCH_X86)
+
+#if MACOS_OS
+#define CALL_ON_STACK "_vmkitCallOnStack"
+#else
+#define CALL_ON_STACK "vmkitCallOnStack"
+#endif
+
+/// vmkitCallOnStack - Call fct with arg on the given stack and switch back.
+/// The frame pointer chain goes on from the new stack to the old one.
+extern "C" void vmkitCallOnStack(void (*fct)(void*), void* arg, word_t stack);
+
+#if ARCH_X64
+asm(
+  ".text\n"
+  ".globl " CALL_ON_STACK "\n"
+  CALL_ON_STACK ":\n"
+  "  pushq %rbp\n"
+  "  movq %rsp, %rbp\n"
+  "  movq %rdx, %rsp\n"
+  "  movq %rdi, %rax\n"
+  "  movq %rsi, %rdi\n"
+  "  callq *%rax\n"
+  "  movq %rbp, %rsp\n"
+  "  popq %rbp\n"
+  "  ret\n");
+#else
+asm(
+  ".text\n"
+  ".globl " CALL_ON_STACK "\n"
+  CALL_ON_STACK ":\n"
+  "  pushl %ebp\n"
+  "  movl %esp, %ebp\n"
+  "  movl 16(%ebp), %esp\n"
+  "  subl $12, %esp\n"
+  "  pushl 12(%ebp)\n"
+  "  call *8(%ebp)\n"
+  "  movl %ebp, %esp\n"
+  "  popl %ebp\n"
+  "  ret\n");
+#endif
+
+#define SUPPORTS_ATTACH 1
+#endif
+
+/// AttachInfo - What an attached thread keeps at the top of its slot, above
+/// the stack it runs Java code on.
+struct AttachInfo {
+  /// baseFrame - The first known frame of the thread. Stack walks that reach
+  /// the native frames of the thread jump to the base SP from there.
+  KnownFrame baseFrame;
+
+  /// savedAltStack - The signal stack of the native thread before it
+  /// attached.
+  stack_t savedAltStack;
+};
+
+static const word_t AttachInfoSize = (sizeof(AttachInfo) + 15) & ~15;
+
+static AttachInfo* getAttachInfo(Thread* th) {
+  return (AttachInfo*)((word_t)th + kThreadSlotSize - AttachInfoSize);
+}
+
+Thread* Thread::getAttached() {
+  return (Thread*)pthread_getspecific(TheStackManager.attachedKey);
+}
+
+bool Thread::attach() {
+#if SUPPORTS_ATTACH
+  assert(!TheStackManager.isParked((word_t)this) &&
+         "Attaching in the slot of a parked thread");
+  AttachInfo* info = getAttachInfo(this);
+  // No frame of the slot stack ever has the top of the slot as address.
+  baseSP = (word_t)this + kThreadSlotSize;
+  info->baseFrame.currentFP = baseSP;
+  info->baseFrame.currentIP = baseSP;
+  info->baseFrame.previousFrame = NULL;
+  lastKnownFrame = &(info->baseFrame);
+  internalThreadID = (void*)pthread_self();
+
+  // Handle stack overflows of Java code on the signal stack of the slot.
+  stack_t st;
+  st.ss_sp = (void*)GetAlternativeStackEnd();
+  st.ss_flags = 0;
+  st.ss_size = System::GetAlternativeStackSize();
+  sigaltstack(&st, &(info->savedAltStack));
+
+  pthread_setspecific(TheStackManager.attachedKey, this);
+  // Be in uncooperative code before a rendezvous can see the thread.
+  lastSP = baseSP;
+  MyVM->addThread(this);
+  MyVM->rendezvous.addThread(this);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Thread::detach() {
+  assert(getAttached() == this && "Detaching a thread that did not attach");
+  assert(lastSP == baseSP && "Detaching a thread inside the VM");
+  MyVM->rendezvous.logThreadHistogram(this);
+  stack_t saved = getAttachInfo(this)->savedAltStack;
+  if (saved.ss_flags & SS_DISABLE) {
+    saved.ss_sp = NULL;
+    saved.ss_size = 0;
+  }
+  sigaltstack(&saved, NULL);
+  pthread_setspecific(TheStackManager.attachedKey, NULL);
+  // The native thread does not die: releaseThread must not join it.
+  internalThreadID = NULL;
+  MyVM->removeThread(this);
+  // From now on, the slot may be allocated again.
+}
+
+/// StackCall - A call made on the stack of a slot.
+struct StackCall {
+  void (*fct)(void*);
+  void* arg;
+};
+
+/// runOnStack - The first function on the slot stack. Makes the known frames
+/// go back to the native stack, and keeps exceptions on the slot stack.
+static void runOnStack(void* arg) {
+  StackCall* call = (StackCall*)arg;
+  Thread* th = Thread::get();
+  word_t cur = System::GetCallerAddress();
+  word_t caller = System::GetCallerOfAddress(cur);
+
+  KnownFrame native;
+  native.previousFrame = th->lastKnownFrame;
+  native.currentFP = caller;
+  native.currentIP = System::GetIPFromCallerAddress(caller);
+  KnownFrame slot;
+  slot.previousFrame = &native;
+  slot.currentFP = cur;
+  slot.currentIP = 0;
+  th->lastKnownFrame = &slot;
+
+  TRY {
+    call->fct(call->arg);
+  } CATCH {
+    // The caller checks for the pending exception.
+  } END_CATCH;
+
+  th->lastKnownFrame = native.previousFrame;
+}
+
+void Thread::callOnStack(void (*fct)(void*), void* arg) {
+#if SUPPORTS_ATTACH
+  assert(getAttached() == this && "Calling on the stack of another thread");
+  StackCall call = { fct, arg };
+  vmkitCallOnStack(runOnStack, &call, (word_t)getAttachInfo(this));
+#else
+  UNREACHABLE();
+#endif
 }
 
 void Thread::throwNullPointerException(word_t methodIP)
@@ -20,10 +20,16 @@ class MutatorThread : public vmkit::Thread {
 public:
   MutatorThread() : vmkit::Thread() {
     MutatorContext = 0;
+    CollectorContext = 0;
     CollectionAttempts = 0;
   }
   vmkit::ThreadAllocator Allocator;
   word_t MutatorContext;
+
+  /// CollectorContext - The MMTk collector context of a collector thread.
+  /// Other threads collect with the bootstrap collector.
+  ///
+  word_t CollectorContext;
   
   /// realRoutine - The function to invoke when the thread starts.
   ///
@@ -42,6 +48,13 @@ public:
     routine = init;
     return Thread::start(init);
   }
+
+  /// attach - Attach the current native thread, with its own allocation
+  /// context.
+  virtual bool attach();
+
+  /// detach - Give the allocation context back and detach.
+  virtual void detach();
 };
 
 }
@@ -125,6 +125,14 @@ void MutatorThread::init(Thread* _th) {
   th->realRoutine(_th);
 }
 
+bool MutatorThread::attach() {
+  return Thread::attach();
+}
+
+void MutatorThread::detach() {
+  Thread::detach();
+}
+
 bool Collector::isLive(gc* ptr, word_t closure) {
   abort();
   return false;
@@ -214,6 +222,9 @@ void Collector::collect() {
 void Collector::initialise(int argc, char** argv) {
 }
 
+void Collector::startCollectorThreads(VirtualMachine* vm) {
+}
+
 bool Collector::needsWriteBarrier() {
   return false;
 }
@@ -36,6 +36,8 @@ extern "C" void fieldWriteBarrier(void* ref, void** ptr, void* value);
 extern "C" void nonHeapWriteBarrier(void** ptr, void* value);
 
 namespace vmkit {
+
+class VirtualMachine;
   
 class Collector {
 public:
@@ -60,6 +62,10 @@ public:
   static void collect();
   
   static void initialise(int argc, char** argv);
+
+  /// startCollectorThreads - Start the threads that collect in parallel with
+  /// the thread that triggers a collection.
+  static void startCollectorThreads(VirtualMachine* vm);
   
   static int getMaxMemory() {
     return 0;
@@ -31,13 +31,13 @@ void MethodInfoHelper::scan(word_t closure, FrameInfo* FI, word_t ip, word_t add
   }
 }
 
-void MethodInfoHelper::print(word_t ip, word_t addr) {
+void MethodInfoHelper::print(word_t ip, word_t addr, FILE* out) {
   Dl_info info;
   int res = dladdr((void*)ip, &info);
   if (res != 0 && info.dli_sname != NULL) {
-    fprintf(stderr, "; %p (%p) in %s\n",  (void*)ip, (void*)addr, info.dli_sname);
+    fprintf(out, "; %p (%p) in %s\n",  (void*)ip, (void*)addr, info.dli_sname);
   } else {
-    fprintf(stderr, "; %p in Unknown method\n", (void*)ip);
+    fprintf(out, "; %p in Unknown method\n", (void*)ip);
   }
 }
 
@@ -62,6 +62,8 @@ void VirtualMachine::waitForExit() {
 }
 
 void VirtualMachine::exit() { 
+  rendezvous.dumpSafepointHistograms();
+  dumpLockProfile();
   doExit = true;
   threadLock.lock();
   threadVar.signal();
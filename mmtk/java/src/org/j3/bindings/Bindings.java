@@ -11,6 +11,7 @@ package org.j3.bindings;
 
 import org.j3.config.Selected;
 import org.j3.options.OptionSet;
+import org.mmtk.plan.CollectorContext;
 import org.mmtk.plan.MutatorContext;
 import org.mmtk.plan.Plan;
 import org.mmtk.plan.TraceLocal;
@@ -131,6 +132,20 @@ public final class Bindings {
     mutator.deinitMutator();
   }
 
+  @Inline
+  private static CollectorContext allocateCollector(int id) {
+    Selected.Collector collector = new Selected.Collector();
+    collector.initCollector(id);
+    return collector;
+  }
+
+  @Inline
+  private static void runCollector() {
+    Selected.Collector.get().collect();
+  }
+
+  private static native void runCollectors();
+
   @Inline
   private static void boot(Extent minSize, Extent maxSize, String[] arguments) {
     if (arguments != null) {
@@ -239,7 +254,7 @@ public final class Bindings {
     Plan.setCollectionTrigger(why);
 
     long startTime = VM.statistics.nanoTime();
-    Selected.Collector.staticCollect();
+    runCollectors();
     long elapsedTime = VM.statistics.nanoTime() - startTime;
 
     HeapGrowthManager.recordGCTime(((double)elapsedTime) / 1000000);
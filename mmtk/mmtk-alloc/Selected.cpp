@@ -9,6 +9,7 @@
 
 #include "MutatorThread.h"
 #include "VmkitGC.h"
+#include "../mmtk-j3/CollectorThread.h"
 #include "../mmtk-j3/MMTkObject.h"
 
 #include "vmkit/VirtualMachine.h"
@@ -175,6 +176,26 @@ void MutatorThread::init(Thread* _th) {
   JnJVM_org_j3_bindings_Bindings_freeMutator__Lorg_mmtk_plan_MutatorContext_2(context);
 }
 
+bool MutatorThread::attach() {
+  if (!Thread::attach()) return false;
+  // The thread attached in uncooperative code, but MMTk must not see a
+  // collection while it creates the context.
+  leaveUncooperativeCode();
+  MutatorContext =
+    JnJVM_org_j3_bindings_Bindings_allocateMutator__I((int32_t)getThreadID());
+  enterUncooperativeCode(baseSP);
+  return true;
+}
+
+void MutatorThread::detach() {
+  leaveUncooperativeCode();
+  word_t context = MutatorContext;
+  MutatorContext = 0;
+  JnJVM_org_j3_bindings_Bindings_freeMutator__Lorg_mmtk_plan_MutatorContext_2(context);
+  enterUncooperativeCode(baseSP);
+  Thread::detach();
+}
+
 bool Collector::isLive(gc* ptr, word_t closure) {
   llvm_gcroot(ptr, 0);
   return JnJVM_org_j3_bindings_Bindings_isLive__Lorg_mmtk_plan_TraceLocal_2Lorg_vmmagic_unboxed_ObjectReference_2(closure, ptr);
@@ -238,13 +259,28 @@ void Collector::collect() {
 static const char* kPrefix = "-X:gc:";
 static const int kPrefixLength = strlen(kPrefix);
 
+/// kThreadsOption - The number of collectors. Read by VMKit, not by MMTk.
+static const char* kThreadsOption = "-X:gc:threads=";
+static const int kThreadsOptionLength = strlen(kThreadsOption);
+
+static bool isThreadsOption(const char* arg) {
+  return !strncmp(arg, kThreadsOption, kThreadsOptionLength);
+}
+
 void Collector::initialise(int argc, char** argv) {
   int i = 1;
   int count = 0;
   ThreadAllocator allocator;
   mmtk::MMTkObjectArray* arguments = NULL;
   while (i < argc && argv[i][0] == '-') {
-    if (!strncmp(argv[i], kPrefix, kPrefixLength)) {
+    if (isThreadsOption(argv[i])) {
+      int threads = atoi(argv[i] + kThreadsOptionLength);
+      if (threads < 1) threads = 1;
+      if (threads > (int)mmtk::CollectorThread::kMaxCollectors) {
+        threads = mmtk::CollectorThread::kMaxCollectors;
+      }
+      mmtk::CollectorThread::nbCollectors = threads;
+    } else if (!strncmp(argv[i], kPrefix, kPrefixLength)) {
       count++;
     }
     i++;
@@ -257,7 +293,8 @@ void Collector::initialise(int argc, char** argv) {
     i = 1;
     int arrayIndex = 0;
     while (i < argc && argv[i][0] == '-') {
-      if (!strncmp(argv[i], kPrefix, kPrefixLength)) {
+      if (!strncmp(argv[i], kPrefix, kPrefixLength) &&
+          !isThreadsOption(argv[i])) {
         int size = strlen(argv[i]) - kPrefixLength;
         mmtk::MMTkArray* array = reinterpret_cast<mmtk::MMTkArray*>(
             allocator.Allocate(sizeof(mmtk::MMTkArray) + size * sizeof(uint16_t)));
@@ -280,6 +317,10 @@ void Collector::initialise(int argc, char** argv) {
   JnJVM_org_j3_bindings_Bindings_boot__Lorg_vmmagic_unboxed_Extent_2Lorg_vmmagic_unboxed_Extent_2_3Ljava_lang_String_2(20 * 1024 * 1024, 100 * 1024 * 1024, arguments);
 }
 
+void Collector::startCollectorThreads(VirtualMachine* vm) {
+  mmtk::CollectorThread::startCollectors(vm);
+}
+
 extern "C" void* MMTkMutatorAllocate(uint32_t size, void* type) {
   gcHeader* head = NULL;
   size += gcHeader::hiddenHeaderSize();
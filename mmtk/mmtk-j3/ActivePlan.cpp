@@ -9,36 +9,53 @@
 
 #include "debug.h"
 #include "vmkit/VirtualMachine.h"
+#include "vmkit/Locks.h"
+#include "CollectorThread.h"
 #include "MMTkObject.h"
 #include "MutatorThread.h"
 
 namespace mmtk {
 
+/// mutatorIteratorLock - Collectors share the iteration over mutators, and
+/// each mutator is returned to one of them only.
+static vmkit::SpinLock mutatorIteratorLock;
+
+/// mutatorsDone - Set when the iteration reached the end, so that collectors
+/// asking for another mutator do not start it over.
+static bool mutatorsDone = false;
+
 extern "C" MMTkObject* Java_org_j3_mmtk_ActivePlan_getNextMutator__(MMTkActivePlan* A) {
   assert(A && "No active plan");
-  
-  if (A->current == NULL) {
-    A->current = (vmkit::MutatorThread*)vmkit::Thread::get()->MyVM->mainThread;
-  } else if (A->current->next() == vmkit::Thread::get()->MyVM->mainThread) {
-    A->current = NULL;
-    return NULL;
-  } else {
-    A->current = (vmkit::MutatorThread*)A->current->next();
-  }
+  vmkit::Thread* main = vmkit::Thread::get()->MyVM->mainThread;
+  word_t context = 0;
 
-  if (A->current->MutatorContext == 0) {
-    return Java_org_j3_mmtk_ActivePlan_getNextMutator__(A);
+  mutatorIteratorLock.acquire();
+  while (!mutatorsDone && context == 0) {
+    if (A->current == NULL) {
+      A->current = (vmkit::MutatorThread*)main;
+    } else if (A->current->next() == main) {
+      A->current = NULL;
+      mutatorsDone = true;
+      break;
+    } else {
+      A->current = (vmkit::MutatorThread*)A->current->next();
+    }
+    context = A->current->MutatorContext;
   }
-  return (MMTkObject*)A->current->MutatorContext;
+  mutatorIteratorLock.release();
+
+  return (MMTkObject*)context;
 }
 
 extern "C" void Java_org_j3_mmtk_ActivePlan_resetMutatorIterator__(MMTkActivePlan* A) {
+  mutatorIteratorLock.acquire();
   A->current = NULL;
+  mutatorsDone = false;
+  mutatorIteratorLock.release();
 }
 
 extern "C" int Java_org_j3_mmtk_ActivePlan_collectorCount__ (MMTkActivePlan* A) {
-  // We do not support parallel GC yet.
-  return 1;
+  return CollectorThread::nbActive;
 }
 
 }
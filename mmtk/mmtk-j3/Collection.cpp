@@ -9,6 +9,7 @@
 
 #include "debug.h"
 #include "vmkit/VirtualMachine.h"
+#include "CollectorThread.h"
 #include "MMTkObject.h"
 #include "VmkitGC.h"
 
@@ -25,26 +26,37 @@ extern "C" void Java_org_j3_mmtk_Collection_reportAllocationSuccess__ (MMTkObjec
 
 extern "C" void JnJVM_org_j3_bindings_Bindings_collect__I(int why);
 
+/// nbCollections - The number of collections so far. Written by the
+/// initiator of a collection before it releases the other threads.
+static volatile int32_t nbCollections = 0;
+
 extern "C" void Java_org_j3_mmtk_Collection_triggerCollection__I (MMTkObject* C, int why) {
   vmkit::MutatorThread* th = vmkit::MutatorThread::get();
   if (why > 2) th->CollectionAttempts++;
 
-  // Verify that another collection is not happening.
-  th->MyVM->rendezvous.startRV();
-  if (th->MyVM->rendezvous.getInitiator() != NULL) {
+  // Verify that another collection is not happening. Any collection that
+  // ends from now on will do, but the rendezvous may also belong to a
+  // handshake or a bias revocation, which do not collect: try again after
+  // those.
+  int32_t seen = nbCollections;
+  while (!th->MyVM->rendezvous.startRV()) {
     th->MyVM->rendezvous.cancelRV();
     th->MyVM->rendezvous.join();
-    return;
-  } else {
-    th->MyVM->startCollection();
-    th->MyVM->rendezvous.synchronize();
+    if (nbCollections != seen) return;
+    vmkit::Thread::yield();
+  }
 
-    JnJVM_org_j3_bindings_Bindings_collect__I(why);
+  vmkit::ThreadAffinity::enterCollector();
+  th->MyVM->startCollection();
+  th->MyVM->rendezvous.synchronize();
+  th->MyVM->deflateIdleLocks();
 
-    th->MyVM->rendezvous.finishRV();
-    th->MyVM->endCollection();
-  }
+  JnJVM_org_j3_bindings_Bindings_collect__I(why);
 
+  nbCollections++;
+  th->MyVM->rendezvous.finishRV();
+  th->MyVM->endCollection();
+  vmkit::ThreadAffinity::leaveCollector();
 }
 
 extern "C" void Java_org_j3_mmtk_Collection_joinCollection__ (MMTkObject* C) {
@@ -53,8 +65,12 @@ extern "C" void Java_org_j3_mmtk_Collection_joinCollection__ (MMTkObject* C) {
   th->MyVM->rendezvous.join();
 }
 
+extern "C" void Java_org_j3_bindings_Bindings_runCollectors__ () {
+  CollectorThread::collect();
+}
+
 extern "C" int Java_org_j3_mmtk_Collection_rendezvous__I (MMTkObject* C, int where) {
-  return 1;
+  return CollectorThread::rendezvous();
 }
 
 extern "C" int Java_org_j3_mmtk_Collection_maximumCollectionAttempt__ (MMTkObject* C) {
@@ -79,8 +95,13 @@ extern "C" void Java_org_j3_mmtk_Collection_prepareCollector__Lorg_mmtk_plan_Col
 extern "C" void Java_org_j3_mmtk_Collection_prepareMutator__Lorg_mmtk_plan_MutatorContext_2 (MMTkObject* C, MMTkObject* MC) {
 }
 
-extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreads__ (MMTkObject* C) { return 1; }
-extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreadOrdinal__ (MMTkObject* C) { return 1; }
+extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreads__ (MMTkObject* C) {
+  return CollectorThread::nbActive;
+}
+
+extern "C" int32_t Java_org_j3_mmtk_Collection_activeGCThreadOrdinal__ (MMTkObject* C) {
+  return CollectorThread::getOrdinal();
+}
 
 
 extern "C" void Java_org_j3_mmtk_Collection_reportPhysicalAllocationFailed__ (MMTkObject* C) { UNIMPLEMENTED(); }
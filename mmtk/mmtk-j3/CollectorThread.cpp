@@ -0,0 +1,107 @@
+//===------ CollectorThread.cpp - Threads for parallel collection ---------===//
+//
+//                              The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "debug.h"
+#include "vmkit/System.h"
+#include "vmkit/VirtualMachine.h"
+#include "CollectorThread.h"
+#include "MMTkObject.h"
+
+#include <climits>
+
+extern "C" word_t JnJVM_org_j3_bindings_Bindings_allocateCollector__I(int32_t) ALWAYS_INLINE;
+extern "C" void JnJVM_org_j3_bindings_Bindings_runCollector__() ALWAYS_INLINE;
+
+namespace mmtk {
+
+uint32_t CollectorThread::nbCollectors = 1;
+CollectorThread* CollectorThread::collectors[kMaxCollectors];
+volatile int32_t CollectorThread::nbReady = 0;
+volatile int32_t CollectorThread::nbActive = 1;
+volatile int32_t CollectorThread::nbRunning = 0;
+volatile int32_t CollectorThread::nbArrived = 0;
+volatile int32_t CollectorThread::barrierEpoch = 0;
+
+void CollectorThread::collectorStart(CollectorThread* th) {
+  th->CollectorContext =
+    JnJVM_org_j3_bindings_Bindings_allocateCollector__I(th->ordinal);
+
+  // From now on the thread never reaches a safe point. A rendezvous counts
+  // it as joined, and it collects while the other threads are stopped.
+  th->enterUncooperativeCode();
+  __sync_add_and_fetch(&nbReady, 1);
+
+  while (true) {
+    while (th->work == 0) vmkit::System::FutexWait(&th->work, 0);
+    JnJVM_org_j3_bindings_Bindings_runCollector__();
+    th->work = 0;
+    if (__sync_sub_and_fetch(&nbRunning, 1) == 0) {
+      vmkit::System::FutexWake(&nbRunning, 1);
+    }
+  }
+}
+
+void CollectorThread::startCollectors(vmkit::VirtualMachine* vm) {
+  for (uint32_t i = 1; i < nbCollectors; ++i) {
+    collectors[i] = new CollectorThread(vm, i);
+    collectors[i]->start((void (*)(vmkit::Thread*))collectorStart);
+  }
+}
+
+void CollectorThread::collect() {
+  int32_t active = 1;
+  if (nbReady == (int32_t)nbCollectors - 1) active = nbCollectors;
+  nbActive = active;
+  nbRunning = active - 1;
+  __sync_synchronize();
+
+  for (int32_t i = 1; i < active; ++i) {
+    collectors[i]->work = 1;
+    vmkit::System::FutexWake(&collectors[i]->work, 1);
+  }
+
+  JnJVM_org_j3_bindings_Bindings_runCollector__();
+
+  // The last phase ends with a rendezvous, but collector threads must be
+  // back waiting for work before the next collection.
+  int32_t running = 0;
+  while ((running = nbRunning) != 0) {
+    vmkit::System::FutexWait(&nbRunning, running);
+  }
+}
+
+int32_t CollectorThread::rendezvous() {
+  int32_t active = nbActive;
+  if (active == 1) return 1;
+
+  int32_t epoch = barrierEpoch;
+  int32_t order = __sync_add_and_fetch(&nbArrived, 1);
+  if (order == active) {
+    nbArrived = 0;
+    __sync_add_and_fetch(&barrierEpoch, 1);
+    vmkit::System::FutexWake(&barrierEpoch, INT_MAX);
+  } else {
+    for (uint32_t i = 0; i < kSpinCount && barrierEpoch == epoch; ++i) {
+      vmkit::System::Pause();
+    }
+    while (barrierEpoch == epoch) {
+      vmkit::System::FutexWait(&barrierEpoch, epoch);
+    }
+  }
+  return order;
+}
+
+int32_t CollectorThread::getOrdinal() {
+  vmkit::MutatorThread* th = vmkit::MutatorThread::get();
+  // Only collector threads have a context of their own.
+  if (th->CollectorContext == 0) return 0;
+  return static_cast<CollectorThread*>(th)->ordinal;
+}
+
+} // namespace mmtk
@@ -0,0 +1,114 @@
+//===------- CollectorThread.h - Threads for parallel collection ----------===//
+//
+//                              The VMKit project
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef MMTK_COLLECTOR_THREAD_H
+#define MMTK_COLLECTOR_THREAD_H
+
+#include <stdint.h>
+#include "MutatorThread.h"
+
+namespace vmkit {
+  class VirtualMachine;
+}
+
+namespace mmtk {
+
+/// CollectorThread - A thread dedicated to running an MMTk collector context.
+/// The thread that starts a collection is collector 0 and uses the bootstrap
+/// collector of Selected.Collector. Collector threads run the same phases in
+/// parallel with it, and synchronize with Collection.rendezvous.
+///
+class CollectorThread : public vmkit::MutatorThread {
+public:
+  /// ordinal - The index of this collector, from 1.
+  ///
+  uint32_t ordinal;
+
+  /// work - Set to 1 by the thread that starts a collection, and back to 0
+  /// by this thread once it is done. The thread futex-waits on this word.
+  ///
+  volatile int32_t work;
+
+  CollectorThread(vmkit::VirtualMachine* vm, uint32_t i) {
+    MyVM = vm;
+    ordinal = i;
+    work = 0;
+  }
+
+  virtual vmkit::ThreadAffinity::Role getAffinityRole() {
+    return vmkit::ThreadAffinity::Collector;
+  }
+
+  /// start - Collector threads have no mutator context.
+  ///
+  virtual int start(void (*fct)(vmkit::Thread*)) {
+    return vmkit::Thread::start(fct);
+  }
+
+  static void collectorStart(CollectorThread* th);
+
+  /// kMaxCollectors - The maximum number of collectors, which is also the
+  /// maximum of MMTk's Immix space.
+  ///
+  static const uint32_t kMaxCollectors = 64;
+
+  /// kSpinCount - How long a collector spins in a rendezvous before it
+  /// sleeps. Phases are short, so most rendezvous end while spinning.
+  ///
+  static const uint32_t kSpinCount = 1000;
+
+  /// nbCollectors - The number of collectors, set with -X:gc:threads.
+  ///
+  static uint32_t nbCollectors;
+
+  static CollectorThread* collectors[kMaxCollectors];
+
+  /// nbReady - The number of collector threads waiting for work. Until all
+  /// of them are, collections run on the initiator only.
+  ///
+  static volatile int32_t nbReady;
+
+  /// nbActive - The number of collectors taking part in the current
+  /// collection.
+  ///
+  static volatile int32_t nbActive;
+
+  /// nbRunning - The number of collector threads not done with the current
+  /// collection. The initiator futex-waits on this word.
+  ///
+  static volatile int32_t nbRunning;
+
+  /// nbArrived, barrierEpoch - The state of the rendezvous. Collectors count
+  /// themselves in nbArrived, and the last one increments barrierEpoch.
+  ///
+  static volatile int32_t nbArrived;
+  static volatile int32_t barrierEpoch;
+
+  /// startCollectors - Start the collector threads of the VM.
+  ///
+  static void startCollectors(vmkit::VirtualMachine* vm);
+
+  /// collect - Run a collection on all collectors. Called by the initiator,
+  /// with the other threads stopped.
+  ///
+  static void collect();
+
+  /// rendezvous - Wait for all active collectors. Returns the order in which
+  /// the current collector arrived, from 1.
+  ///
+  static int32_t rendezvous();
+
+  /// getOrdinal - The index of the current collector, from 0.
+  ///
+  static int32_t getOrdinal();
+};
+
+} // namespace mmtk
+
+#endif // MMTK_COLLECTOR_THREAD_H
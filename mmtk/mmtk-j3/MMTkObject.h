@@ -60,6 +60,10 @@ struct MMTkLock : public MMTkObject {
   MMTkString* name;
 };
 
+struct MMTkSynchronizedCounter : public MMTkObject {
+  int32_t count;
+};
+
 struct MMTkActivePlan : public MMTkObject {
   vmkit::MutatorThread* current;
 };
@@ -9,41 +9,96 @@
 
 #include "debug.h"
 #include "vmkit/VirtualMachine.h"
+#include "vmkit/Locks.h"
+#include "CollectorThread.h"
 #include "MMTkObject.h"
 #include "VmkitGC.h"
 
 namespace mmtk {
 
+/// ThreadCursor - An iteration over the threads of the VM shared by the
+/// collectors. Each thread is returned to one collector only.
+///
+class ThreadCursor {
+  vmkit::SpinLock lock;
+  vmkit::Thread* current;
+  bool done;
+
+public:
+  ThreadCursor() {
+    current = NULL;
+    done = false;
+  }
+
+  vmkit::Thread* next() {
+    vmkit::Thread* main = vmkit::Thread::get()->MyVM->mainThread;
+    vmkit::Thread* res = NULL;
+    lock.acquire();
+    if (!done) {
+      if (current == NULL) {
+        current = main;
+      } else if (current->next() == main) {
+        current = NULL;
+        done = true;
+      } else {
+        current = (vmkit::Thread*)current->next();
+      }
+      res = current;
+    }
+    lock.release();
+    return res;
+  }
+
+  void reset() {
+    lock.acquire();
+    current = NULL;
+    done = false;
+    lock.release();
+  }
+};
+
+/// stackCursor, tracerCursor - The threads whose stack, and whose other
+/// roots, are still to be scanned.
+///
+static ThreadCursor stackCursor;
+static ThreadCursor tracerCursor;
+
+/// nextRootPacket - The next root packet of the VM to be traced.
+///
+static volatile int32_t nextRootPacket = 0;
+
 extern "C" void Java_org_j3_mmtk_Scanning_computeThreadRoots__Lorg_mmtk_plan_TraceLocal_2 (MMTkObject* Scanning, MMTkObject* TL) {
   // When entering this function, all threads are waiting on the rendezvous to
-  // finish.
-  vmkit::Thread* th = vmkit::Thread::get();
-  vmkit::Thread* tcur = th;
-  
-  do {
+  // finish. Every collector runs this phase, and scans the stacks it claims.
+  vmkit::Thread* tcur = NULL;
+  while ((tcur = stackCursor.next()) != NULL) {
     tcur->scanStack(reinterpret_cast<word_t>(TL));
-    tcur = (vmkit::Thread*)tcur->next();
-  } while (tcur != th);
+  }
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_computeGlobalRoots__Lorg_mmtk_plan_TraceLocal_2 (MMTkObject* Scanning, MMTkObject* TL) { 
-  vmkit::Thread::get()->MyVM->tracer(reinterpret_cast<word_t>(TL));
-  
-	vmkit::Thread* th = vmkit::Thread::get();
-  vmkit::Thread* tcur = th;
-  
-  do {
+  vmkit::VirtualMachine* vm = vmkit::Thread::get()->MyVM;
+  int32_t nbPackets = vm->getNbRootPackets();
+  int32_t packet = 0;
+  while ((packet = __sync_fetch_and_add(&nextRootPacket, 1)) < nbPackets) {
+    vm->traceRootPacket(packet, reinterpret_cast<word_t>(TL));
+  }
+
+  vmkit::Thread* tcur = NULL;
+  while ((tcur = tracerCursor.next()) != NULL) {
     tcur->tracer(reinterpret_cast<word_t>(TL));
-    tcur = (vmkit::Thread*)tcur->next();
-  } while (tcur != th);
+  }
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_computeStaticRoots__Lorg_mmtk_plan_TraceLocal_2 (MMTkObject* Scanning, MMTkObject* TL) {
-  // Nothing to do.
+  // Nothing to do, the static fields are in the root packets of the VM.
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_resetThreadCounter__ (MMTkObject* Scanning) {
-  // Nothing to do.
+  // Called once the roots are scanned, ready for the next collection.
+  stackCursor.reset();
+  tracerCursor.reset();
+  nextRootPacket = 0;
 }
 
 extern "C" void Java_org_j3_mmtk_Scanning_specializedScanObject__ILorg_mmtk_plan_TransitiveClosure_2Lorg_vmmagic_unboxed_ObjectReference_2 (MMTkObject* Scanning, uint32_t id, MMTkObject* TC, gc* obj) ALWAYS_INLINE;
@@ -16,4 +16,8 @@ extern "C" MMTkObject* Java_org_j3_config_Selected_00024Mutator_get__() {
   return (MMTkObject*)vmkit::MutatorThread::get()->MutatorContext;
 }
 
+extern "C" MMTkObject* Java_org_j3_config_Selected_00024Collector_current__() {
+  return (MMTkObject*)vmkit::MutatorThread::get()->CollectorContext;
+}
+
 }
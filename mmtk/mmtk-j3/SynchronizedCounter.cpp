@@ -13,7 +13,12 @@
 
 namespace mmtk {
 
-extern "C" void Java_org_j3_mmtk_SynchronizedCounter_reset__ (MMTkObject* self) { UNIMPLEMENTED(); }
-extern "C" void Java_org_j3_mmtk_SynchronizedCounter_increment__ (MMTkObject* self) { UNIMPLEMENTED(); }
+extern "C" int32_t Java_org_j3_mmtk_SynchronizedCounter_reset__ (MMTkSynchronizedCounter* self) {
+  return __sync_lock_test_and_set(&self->count, 0);
+}
+
+extern "C" int32_t Java_org_j3_mmtk_SynchronizedCounter_increment__ (MMTkSynchronizedCounter* self) {
+  return __sync_fetch_and_add(&self->count, 1);
+}
 
 } // end namespace mmtk
@@ -0,0 +1,49 @@
+// Measures how fast threads inflate the locks of fresh objects at the same
+// time. Waiting with a pending interrupt inflates the lock without sleeping.
+// Run with 1, 2, 4, ... threads: the rate should grow with the thread count.
+public class LockInflationBenchmark {
+
+  static void inflate(int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      Object o = new Object();
+      Thread.currentThread().interrupt();
+      synchronized (o) {
+        try {
+          o.wait();
+        } catch (InterruptedException e) {
+          // Expected.
+        }
+      }
+    }
+  }
+
+  static void run(int threadCount, final int iterations) throws Exception {
+    Thread[] threads = new Thread[threadCount];
+    for (int i = 0; i < threadCount; ++i) {
+      threads[i] = new Thread() {
+        public void run() {
+          inflate(iterations);
+        }
+      };
+    }
+    for (int i = 0; i < threadCount; ++i) threads[i].start();
+    for (int i = 0; i < threadCount; ++i) threads[i].join();
+  }
+
+  public static void main(String[] args) throws Exception {
+    int threadCount = args.length > 0 ? Integer.parseInt(args[0]) : 4;
+    int iterations = args.length > 1 ? Integer.parseInt(args[1]) : 200000;
+
+    // Warm up the compiler.
+    run(threadCount, iterations / 10);
+
+    long start = System.nanoTime();
+    run(threadCount, iterations);
+    long elapsed = System.nanoTime() - start;
+    long total = (long)threadCount * iterations;
+
+    System.out.println(total + " inflations by " + threadCount +
+                       " threads in " + (elapsed / 1000000) + " ms, " +
+                       (total * 1000000000L / elapsed) + " per second");
+  }
+}
@@ -0,0 +1,54 @@
+// Measures the throughput of threads contending for one monitor with short
+// critical sections, the case where spinning beats parking. Run with a
+// varying thread count and critical section length to compare builds.
+public class MonitorContentionBenchmark {
+
+  static final Object lock = new Object();
+  static long counter;
+  static volatile int sink;
+
+  static void work(int length) {
+    for (int i = 0; i < length; ++i) sink++;
+  }
+
+  static void run(int threadCount, final int iterations, final int length)
+      throws Exception {
+    Thread[] threads = new Thread[threadCount];
+    for (int i = 0; i < threadCount; ++i) {
+      threads[i] = new Thread() {
+        public void run() {
+          for (int j = 0; j < iterations; ++j) {
+            synchronized (lock) {
+              counter++;
+              work(length);
+            }
+            work(length);
+          }
+        }
+      };
+    }
+    for (int i = 0; i < threadCount; ++i) threads[i].start();
+    for (int i = 0; i < threadCount; ++i) threads[i].join();
+  }
+
+  public static void main(String[] args) throws Exception {
+    int threadCount = args.length > 0 ? Integer.parseInt(args[0]) : 4;
+    int iterations = args.length > 1 ? Integer.parseInt(args[1]) : 1000000;
+    int length = args.length > 2 ? Integer.parseInt(args[2]) : 10;
+
+    // Warm up the compiler.
+    run(threadCount, iterations / 10, length);
+
+    counter = 0;
+    long start = System.nanoTime();
+    run(threadCount, iterations, length);
+    long elapsed = System.nanoTime() - start;
+    long total = (long)threadCount * iterations;
+    if (counter != total) throw new Error("Lost updates: " + counter);
+
+    System.out.println(total + " acquisitions by " + threadCount +
+                       " threads in " + (elapsed / 1000000) + " ms, " +
+                       (total * 1000000000L / elapsed) + " per second, " +
+                       (elapsed / total) + " ns each");
+  }
+}
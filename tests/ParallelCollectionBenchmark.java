@@ -0,0 +1,52 @@
+// Measures the pause of full collections with a large live heap, to compare
+// runs with different numbers of collector threads (-X:gc:threads=N). The
+// live data is a set of binary trees, so that marking has work to share
+// between collectors, and garbage is allocated between collections so that
+// sweeping has work as well.
+public class ParallelCollectionBenchmark {
+
+  static final class Node {
+    Node left;
+    Node right;
+  }
+
+  static Node tree(int depth) {
+    Node node = new Node();
+    if (depth > 0) {
+      node.left = tree(depth - 1);
+      node.right = tree(depth - 1);
+    }
+    return node;
+  }
+
+  static volatile Object sink;
+
+  public static void main(String[] args) throws Exception {
+    int trees = args.length > 0 ? Integer.parseInt(args[0]) : 16;
+    int depth = args.length > 1 ? Integer.parseInt(args[1]) : 16;
+    int collections = args.length > 2 ? Integer.parseInt(args[2]) : 20;
+
+    Node[] live = new Node[trees];
+    for (int i = 0; i < trees; ++i) live[i] = tree(depth);
+
+    // Warm up the compiler and the heap.
+    System.gc();
+
+    long total = 0;
+    long max = 0;
+    for (int i = 0; i < collections; ++i) {
+      for (int j = 0; j < trees; ++j) sink = tree(depth - 4);
+      long start = System.nanoTime();
+      System.gc();
+      long elapsed = System.nanoTime() - start;
+      total += elapsed;
+      if (elapsed > max) max = elapsed;
+    }
+
+    System.out.println(collections + " collections of " + trees +
+                       " trees of depth " + depth + ": " +
+                       (total / collections / 1000) + " us average, " +
+                       (max / 1000) + " us max");
+    if (live[0] == null) throw new Error();
+  }
+}
@@ -0,0 +1,48 @@
+import java.util.concurrent.locks.LockSupport;
+
+// Measures how fast two threads hand a turn to each other with
+// LockSupport.park and unpark. Each round trip unparks a thread that may
+// already sleep, or that has not parked yet and then takes its permit
+// without sleeping.
+public class ParkUnparkBenchmark {
+
+  static volatile int turn;
+
+  static void pingPong(int me, Thread other, int iterations) {
+    for (int i = 0; i < iterations; ++i) {
+      while (turn != me) LockSupport.park();
+      turn = 1 - me;
+      LockSupport.unpark(other);
+    }
+  }
+
+  static void run(final int iterations) throws Exception {
+    turn = 0;
+    final Thread[] threads = new Thread[2];
+    for (int i = 0; i < 2; ++i) {
+      final int me = i;
+      threads[i] = new Thread() {
+        public void run() {
+          pingPong(me, threads[1 - me], iterations);
+        }
+      };
+    }
+    for (int i = 0; i < 2; ++i) threads[i].start();
+    for (int i = 0; i < 2; ++i) threads[i].join();
+  }
+
+  public static void main(String[] args) throws Exception {
+    int iterations = args.length > 0 ? Integer.parseInt(args[0]) : 1000000;
+
+    // Warm up the compiler.
+    run(iterations / 10);
+
+    long start = System.nanoTime();
+    run(iterations);
+    long elapsed = System.nanoTime() - start;
+
+    System.out.println(iterations + " round trips in " +
+                       (elapsed / 1000000) + " ms, " +
+                       (elapsed / iterations) + " ns per round trip");
+  }
+}
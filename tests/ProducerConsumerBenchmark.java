@@ -0,0 +1,80 @@
+// Measures producers and consumers handing items through a small bounded
+// buffer guarded by its monitor, with wait and notifyAll. Each notifyAll
+// moves every waiter to the entry queue of the monitor, and only one of
+// them is woken up at each release, instead of all of them waking up to
+// block again on the monitor. Compare the voluntary context switches of
+// the process (e.g. with /usr/bin/time -v) before and after the change.
+public class ProducerConsumerBenchmark {
+
+  static class Buffer {
+    final int[] items;
+    int head;
+    int count;
+
+    Buffer(int capacity) {
+      items = new int[capacity];
+    }
+
+    synchronized void put(int item) throws InterruptedException {
+      while (count == items.length) wait();
+      items[(head + count) % items.length] = item;
+      ++count;
+      notifyAll();
+    }
+
+    synchronized int take() throws InterruptedException {
+      while (count == 0) wait();
+      int item = items[head];
+      head = (head + 1) % items.length;
+      --count;
+      notifyAll();
+      return item;
+    }
+  }
+
+  static void run(int pairs, final int iterations) throws Exception {
+    final Buffer buffer = new Buffer(4);
+    Thread[] threads = new Thread[2 * pairs];
+    for (int i = 0; i < pairs; ++i) {
+      threads[2 * i] = new Thread() {
+        public void run() {
+          try {
+            for (int j = 0; j < iterations; ++j) buffer.put(j);
+          } catch (InterruptedException e) {
+            throw new Error(e);
+          }
+        }
+      };
+      threads[2 * i + 1] = new Thread() {
+        public void run() {
+          try {
+            for (int j = 0; j < iterations; ++j) buffer.take();
+          } catch (InterruptedException e) {
+            throw new Error(e);
+          }
+        }
+      };
+    }
+    for (int i = 0; i < threads.length; ++i) threads[i].start();
+    for (int i = 0; i < threads.length; ++i) threads[i].join();
+  }
+
+  public static void main(String[] args) throws Exception {
+    int maxPairs = args.length > 0 ? Integer.parseInt(args[0]) : 8;
+    int iterations = args.length > 1 ? Integer.parseInt(args[1]) : 100000;
+
+    // Warm up the compiler.
+    run(2, iterations / 10);
+
+    for (int pairs = 1; pairs <= maxPairs; pairs *= 2) {
+      long start = System.nanoTime();
+      run(pairs, iterations);
+      long elapsed = System.nanoTime() - start;
+      long total = (long)pairs * iterations;
+
+      System.out.println(pairs + " producers, " + pairs + " consumers: " +
+                         total + " items in " + (elapsed / 1000000) +
+                         " ms, " + (elapsed / total) + " ns each");
+    }
+  }
+}
@@ -0,0 +1,45 @@
+import java.lang.ref.WeakReference;
+
+// Measures the throughput of threads creating weak references, which the VM
+// registers in a queue guarded by one of its internal spin locks. Runs with
+// 1, 2, 4 and up to 64 threads to show how the lock scales with contention
+// and oversubscription.
+public class SpinLockContentionBenchmark {
+
+  static volatile Object sink;
+
+  static void run(int threadCount, final int iterations) throws Exception {
+    Thread[] threads = new Thread[threadCount];
+    for (int i = 0; i < threadCount; ++i) {
+      threads[i] = new Thread() {
+        public void run() {
+          Object referent = new Object();
+          for (int j = 0; j < iterations; ++j) {
+            sink = new WeakReference<Object>(referent);
+          }
+        }
+      };
+    }
+    for (int i = 0; i < threadCount; ++i) threads[i].start();
+    for (int i = 0; i < threadCount; ++i) threads[i].join();
+  }
+
+  public static void main(String[] args) throws Exception {
+    int maxThreads = args.length > 0 ? Integer.parseInt(args[0]) : 64;
+    int iterations = args.length > 1 ? Integer.parseInt(args[1]) : 100000;
+
+    // Warm up the compiler.
+    run(2, iterations / 10);
+
+    for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+      long start = System.nanoTime();
+      run(threadCount, iterations);
+      long elapsed = System.nanoTime() - start;
+      long total = (long)threadCount * iterations;
+
+      System.out.println(threadCount + " threads: " + total +
+                         " references in " + (elapsed / 1000000) + " ms, " +
+                         (elapsed / total) + " ns each");
+    }
+  }
+}
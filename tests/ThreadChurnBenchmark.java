@@ -0,0 +1,35 @@
+// Measures the cost of creating, starting and joining short-lived threads.
+// Run with a varying -Xss and a thread count beyond the first stack chunk.
+public class ThreadChurnBenchmark {
+
+  static volatile int sink;
+
+  public static void main(String[] args) throws Exception {
+    int live = args.length > 0 ? Integer.parseInt(args[0]) : 512;
+    int rounds = args.length > 1 ? Integer.parseInt(args[1]) : 20;
+
+    Runnable work = new Runnable() {
+      public void run() {
+        sink++;
+      }
+    };
+
+    Thread[] threads = new Thread[live];
+    long start = System.nanoTime();
+    for (int r = 0; r < rounds; ++r) {
+      for (int i = 0; i < live; ++i) {
+        threads[i] = new Thread(work);
+        threads[i].start();
+      }
+      for (int i = 0; i < live; ++i) {
+        threads[i].join();
+      }
+    }
+    long elapsed = System.nanoTime() - start;
+    long total = (long)live * rounds;
+
+    System.out.println(total + " threads (" + live + " live) in " +
+                       (elapsed / 1000000) + " ms, " +
+                       (elapsed / total) + " ns per thread");
+  }
+}
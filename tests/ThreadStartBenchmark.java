@@ -0,0 +1,40 @@
+// Measures the latency of Thread.start, from the call to the first
+// instruction of run, and the throughput of one-at-a-time start and join, the
+// pattern of executors that create a thread per task.
+public class ThreadStartBenchmark {
+
+  static volatile long startedAt;
+
+  public static void main(String[] args) throws Exception {
+    int count = args.length > 0 ? Integer.parseInt(args[0]) : 10000;
+
+    Runnable work = new Runnable() {
+      public void run() {
+        startedAt = System.nanoTime();
+      }
+    };
+
+    // Warm up the compiler and the pool of parked threads.
+    for (int i = 0; i < 100; ++i) {
+      Thread t = new Thread(work);
+      t.start();
+      t.join();
+    }
+
+    long latency = 0;
+    long start = System.nanoTime();
+    for (int i = 0; i < count; ++i) {
+      Thread t = new Thread(work);
+      long before = System.nanoTime();
+      t.start();
+      t.join();
+      latency += startedAt - before;
+    }
+    long elapsed = System.nanoTime() - start;
+
+    System.out.println(count + " threads in " + (elapsed / 1000000) +
+                       " ms, " + (count * 1000000000L / elapsed) +
+                       " start/join per second, " + (latency / count) +
+                       " ns start latency");
+  }
+}